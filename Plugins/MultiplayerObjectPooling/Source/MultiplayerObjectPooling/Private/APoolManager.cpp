@@ -3,30 +3,76 @@
 #include "APoolManager.h"
 #include "Engine.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "ObjectPoolSubsystem.h"
 #include "PoolHolder.h"
 
-AAPoolManager* AAPoolManager::Instance;
-
 // Sets default values
 AAPoolManager::AAPoolManager()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = false;
+	PrimaryActorTick.bCanEverTick = true;
+	// The pool manager only ticks while it warms up the pools
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	bWarmUpOverTime = false;
+	WarmUpBudgetMs = 2.f;
+	bAllPoolsReady = false;
 }
 
 // Called when the game starts or when spawned
 void AAPoolManager::BeginPlay()
 {
-	Instance = this;
+	GetWorld()->GetSubsystem<UObjectPoolSubsystem>()->RegisterPoolManager(this);
 	InitializePools();
 	bIsReady = true;
 
 	Super::BeginPlay();
 }
 
-UObject* AAPoolManager::GetFromPool(TSubclassOf<UObject> Class) {
+void AAPoolManager::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	UObjectPoolSubsystem* Subsystem = GetWorld()->GetSubsystem<UObjectPoolSubsystem>();
+	if (Subsystem != nullptr) {
+		Subsystem->UnregisterPoolManager(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+AAPoolManager* AAPoolManager::GetPoolManager(const UObject* WorldContextObject) {
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (World == nullptr) return nullptr;
+
+	UObjectPoolSubsystem* Subsystem = World->GetSubsystem<UObjectPoolSubsystem>();
+	if (Subsystem == nullptr) return nullptr;
+
+	return Subsystem->GetPoolManager();
+}
+
+bool AAPoolManager::AreAllPoolsReady(const UObject* WorldContextObject) {
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) return false;
+
+	return PoolManager->bAllPoolsReady;
+}
+
+void AAPoolManager::Tick(float DeltaSeconds) {
+	Super::Tick(DeltaSeconds);
+
+	// A pool may be emptied by a PoolableBeginPlay of an asynchronous spawn
+	for (int32 i = 0; i < AsyncPools.Num(); i++) {
+		if (IsValid(AsyncPools[i])) {
+			AsyncPools[i]->ProcessAsyncRequests();
+		}
+	}
+
+	if (WarmingPools.Num() > 0) {
+		WarmUpPools();
+	}
+}
+
+UObject* AAPoolManager::GetFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
 	APoolHolder* PoolHolder;
-	if (GetPoolHolder(Class, PoolHolder)) {
+	if (GetPoolHolder(WorldContextObject, Class, PoolHolder)) {
 		if (PoolHolder->IsValidLowLevelFast()) {
 			return PoolHolder->GetUnused();
 		}
@@ -35,9 +81,9 @@ UObject* AAPoolManager::GetFromPool(TSubclassOf<UObject> Class) {
 	return nullptr;
 }
 
-UObject* AAPoolManager::GetSpecificFromPool(TSubclassOf<UObject> Class, FString ObjectName) {
+UObject* AAPoolManager::GetSpecificFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class, FString ObjectName) {
 	APoolHolder* PoolHolder;
-	if (GetPoolHolder(Class, PoolHolder)) {
+	if (GetPoolHolder(WorldContextObject, Class, PoolHolder)) {
 		if (PoolHolder->IsValidLowLevelFast()) {
 			return PoolHolder->GetSpecific(ObjectName);
 		}
@@ -46,14 +92,18 @@ UObject* AAPoolManager::GetSpecificFromPool(TSubclassOf<UObject> Class, FString
 	return nullptr;
 }
 
-bool AAPoolManager::GetPoolHolder(TSubclassOf<UObject> Class, APoolHolder*& PoolHolder) {
+bool AAPoolManager::GetPoolHolder(const UObject* WorldContextObject, TSubclassOf<UObject> Class, APoolHolder*& PoolHolder) {
 	if (Class) {
-		if (IsPoolManagerReady()) {
-			FString Key = Class->GetName();
-			if (Instance->ClassNamesToPools.Contains(Key)) {
-				PoolHolder = *Instance->ClassNamesToPools.Find(Key);
+		AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+		if (IsValid(PoolManager) && PoolManager->IsPoolManagerReady()) {
+			APoolHolder** FoundPoolHolder = PoolManager->ClassesToPools.Find(Class);
+			if (FoundPoolHolder != nullptr) {
+				PoolHolder = *FoundPoolHolder;
 				return true;
 			}
+
+			// Not an error, the caller can check IsPoolLoading
+			if (IsPoolLoading(WorldContextObject, TSoftClassPtr<UObject>(Class.Get()))) return false;
 		}
 
 		UE_LOG(LogTemp, Error, TEXT("Pool Manager is not ready yet!"));
@@ -65,21 +115,25 @@ bool AAPoolManager::GetPoolHolder(TSubclassOf<UObject> Class, APoolHolder*& Pool
 	return false;
 }
 
-TArray<UObject*> AAPoolManager::GetXFromPool(TSubclassOf<UObject> Class, int32 Quantity) {
+TArray<UObject*> AAPoolManager::GetXFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class, int32 Quantity) {
 	TArray<UObject*> Objects;
-	for (int i = 0; i < Quantity; i++) {
-		UObject* Object = GetFromPool(Class);
-		if (Object->IsValidLowLevelFast()) break;
-		
-		Objects.Add(Object);
+
+	APoolHolder* PoolHolder;
+	if (GetPoolHolder(WorldContextObject, Class, PoolHolder)) {
+		if (PoolHolder->IsValidLowLevelFast()) {
+			Objects.Reserve(Quantity);
+			PoolHolder->GetUnusedBatch(Quantity, [&Objects](UObject* Object, int32 Index) {
+				Objects.Add(Object);
+			});
+		}
 	}
 
 	return Objects;
 }
 
-TArray<UObject*> AAPoolManager::GetAllFromPool(TSubclassOf<UObject> Class) {
+TArray<UObject*> AAPoolManager::GetAllFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
 	APoolHolder* PoolHolder;
-	if (GetPoolHolder(Class, PoolHolder)) {
+	if (GetPoolHolder(WorldContextObject, Class, PoolHolder)) {
 		if (PoolHolder->IsValidLowLevelFast()) {
 			return PoolHolder->GetAllUnused();
 		}
@@ -88,17 +142,21 @@ TArray<UObject*> AAPoolManager::GetAllFromPool(TSubclassOf<UObject> Class) {
 	return TArray<UObject*>();
 }
 
-AActor* AAPoolManager::SpawnSpecificActorFromPool(TSubclassOf<AActor> Class, FString ObjectName, FTransform SpawnTransform, AActor* PoolOwner, APawn* PoolInstigator, EBranch& Branch) {
+AActor* AAPoolManager::SpawnSpecificActorFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, FString ObjectName, FTransform SpawnTransform, AActor* PoolOwner, APawn* PoolInstigator, EBranch& Branch) {
 	if (Class) {
-		AActor* UnusedActor = (AActor*)GetSpecificFromPool(Class, ObjectName);
+		// The pool places the actor while it restores it, so it is only moved once
+		APoolHolder* PoolHolder;
+		AActor* UnusedActor = nullptr;
+		if (GetPoolHolder(WorldContextObject, Class, PoolHolder) && IsValid(PoolHolder)) {
+			UnusedActor = (AActor*)PoolHolder->GetSpecific(ObjectName, &SpawnTransform);
+		}
 		if (!IsValid(UnusedActor)) {
-			Branch = EBranch::Failed;
+			Branch = IsPoolLoading(WorldContextObject, TSoftClassPtr<UObject>(Class.Get())) ? EBranch::Loading : EBranch::Failed;
 			return NULL;
 		}
 
-		UnusedActor->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
 		UnusedActor->SetOwner(PoolOwner);
-		UnusedActor->Instigator = PoolInstigator;
+		UnusedActor->SetInstigator(PoolInstigator);
 
 		Branch = EBranch::Success;
 		return UnusedActor;
@@ -109,17 +167,21 @@ AActor* AAPoolManager::SpawnSpecificActorFromPool(TSubclassOf<AActor> Class, FSt
 	return NULL;
 }
 
-AActor* AAPoolManager::SpawnActorFromPool(TSubclassOf<AActor> Class, FTransform SpawnTransform, AActor* PoolOwner, APawn* PoolInstigator, EBranch& Branch) {
+AActor* AAPoolManager::SpawnActorFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, FTransform SpawnTransform, AActor* PoolOwner, APawn* PoolInstigator, EBranch& Branch) {
 	if (Class) {
-		AActor* UnusedActor = (AActor*) GetFromPool(Class);
+		// The pool places the actor while it restores it, so it is only moved once
+		APoolHolder* PoolHolder;
+		AActor* UnusedActor = nullptr;
+		if (GetPoolHolder(WorldContextObject, Class, PoolHolder) && IsValid(PoolHolder)) {
+			UnusedActor = (AActor*)PoolHolder->GetUnused(&SpawnTransform);
+		}
 		if (!IsValid(UnusedActor)) {
-			Branch = EBranch::Failed;
+			Branch = IsPoolLoading(WorldContextObject, TSoftClassPtr<UObject>(Class.Get())) ? EBranch::Loading : EBranch::Failed;
 			return NULL;
 		}
 
-		UnusedActor->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
 		UnusedActor->SetOwner(PoolOwner);
-		UnusedActor->Instigator = PoolInstigator;
+		UnusedActor->SetInstigator(PoolInstigator);
 
 		Branch = EBranch::Success;
 		return UnusedActor;
@@ -130,42 +192,372 @@ AActor* AAPoolManager::SpawnActorFromPool(TSubclassOf<AActor> Class, FTransform
 	return NULL;
 }
 
+UObject* AAPoolManager::GetFromPoolByNetId(const UObject* WorldContextObject, int32 NetId) {
+	APoolHolder* PoolHolder = GetPoolHolderByNetId(WorldContextObject, NetId);
+	if (PoolHolder == nullptr) return nullptr;
+
+	return PoolHolder->GetSpecificBySlot(PoolNetId::GetSlotHandle(NetId));
+}
+
+AActor* AAPoolManager::SpawnActorFromPoolByNetId(const UObject* WorldContextObject, int32 NetId, FTransform SpawnTransform, AActor* PoolOwner, APawn* PoolInstigator, EBranch& Branch) {
+	// Check the class before taking the object, otherwise a non actor would stay in use
+	if (Cast<AActor>(GetObjectByNetId(WorldContextObject, NetId)) == nullptr) {
+		Branch = EBranch::Failed;
+		return NULL;
+	}
+
+	// Fails while the actor is reserved for a worker thread
+	APoolHolder* PoolHolder = GetPoolHolderByNetId(WorldContextObject, NetId);
+	AActor* UnusedActor = PoolHolder != nullptr ? (AActor*)PoolHolder->GetSpecificBySlot(PoolNetId::GetSlotHandle(NetId), &SpawnTransform) : nullptr;
+	if (UnusedActor == nullptr) {
+		Branch = EBranch::Failed;
+		return NULL;
+	}
+
+	UnusedActor->SetOwner(PoolOwner);
+	UnusedActor->SetInstigator(PoolInstigator);
+
+	Branch = EBranch::Success;
+	return UnusedActor;
+}
+
+void AAPoolManager::SpawnActorsFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<FTransform>& SpawnTransforms, AActor* PoolOwner, APawn* PoolInstigator, TArray<AActor*>& SpawnedActors, EBranch& Branch) {
+	// Keeps the allocation of the caller's array
+	SpawnedActors.Reset(SpawnTransforms.Num());
+
+	if (!Class) {
+		UE_LOG(LogTemp, Error, TEXT("Pass a valid class in SpawnActorsFromPool which inherits from Actor!"));
+		Branch = EBranch::Failed;
+		return;
+	}
+
+	APoolHolder* PoolHolder;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder) || !IsValid(PoolHolder)) {
+		Branch = IsPoolLoading(WorldContextObject, TSoftClassPtr<UObject>(Class.Get())) ? EBranch::Loading : EBranch::Failed;
+		return;
+	}
+
+	PoolHolder->GetUnusedBatch(SpawnTransforms.Num(), [&](UObject* Object, int32 Index) {
+		AActor* UnusedActor = (AActor*)Object;
+		UnusedActor->SetOwner(PoolOwner);
+		UnusedActor->SetInstigator(PoolInstigator);
+
+		SpawnedActors.Add(UnusedActor);
+	}, SpawnTransforms.GetData());
+
+	// A partial batch still hands out its actors, but the caller has to know that some are missing
+	Branch = SpawnedActors.Num() == SpawnTransforms.Num() ? EBranch::Success : EBranch::Failed;
+}
+
+APoolHolder* AAPoolManager::GetInstancedPoolHolder(const UObject* WorldContextObject, TSubclassOf<AActor> Class) {
+	APoolHolder* PoolHolder;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder) || !IsValid(PoolHolder)) return nullptr;
+
+	if (!PoolHolder->IsInstanced()) {
+		UE_LOG(LogTemp, Error, TEXT("The pool of %s has no instanced mesh!"), *Class->GetName());
+		return nullptr;
+	}
+
+	return PoolHolder;
+}
+
+int32 AAPoolManager::SpawnInstanceFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, FTransform SpawnTransform) {
+	APoolHolder* PoolHolder = GetInstancedPoolHolder(WorldContextObject, Class);
+	if (PoolHolder == nullptr) return INDEX_NONE;
+
+	TArray<int32> Instances;
+	PoolHolder->AcquireInstances(MakeArrayView(&SpawnTransform, 1), Instances);
+	return Instances[0];
+}
+
+void AAPoolManager::SpawnInstancesFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<FTransform>& SpawnTransforms, TArray<int32>& Instances) {
+	APoolHolder* PoolHolder = GetInstancedPoolHolder(WorldContextObject, Class);
+	if (PoolHolder == nullptr) {
+		Instances.Init(INDEX_NONE, SpawnTransforms.Num());
+		return;
+	}
+
+	PoolHolder->AcquireInstances(SpawnTransforms, Instances);
+}
+
+void AAPoolManager::UpdateInstances(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<int32>& Instances, const TArray<FTransform>& Transforms) {
+	APoolHolder* PoolHolder = GetInstancedPoolHolder(WorldContextObject, Class);
+	if (PoolHolder == nullptr) return;
+
+	PoolHolder->UpdateInstances(Instances, Transforms);
+}
+
+void AAPoolManager::ReturnInstancesToPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<int32>& Instances) {
+	APoolHolder* PoolHolder = GetInstancedPoolHolder(WorldContextObject, Class);
+	if (PoolHolder == nullptr) return;
+
+	PoolHolder->ReleaseInstances(Instances);
+}
+
+AActor* AAPoolManager::MaterializeInstance(const UObject* WorldContextObject, TSubclassOf<AActor> Class, int32 Instance) {
+	APoolHolder* PoolHolder = GetInstancedPoolHolder(WorldContextObject, Class);
+	if (PoolHolder == nullptr) return nullptr;
+
+	return PoolHolder->MaterializeInstance(Instance);
+}
+
+int32 AAPoolManager::GetNumberOfUsedInstances(const UObject* WorldContextObject, TSubclassOf<AActor> Class) {
+	APoolHolder* PoolHolder = GetInstancedPoolHolder(WorldContextObject, Class);
+	if (PoolHolder == nullptr) return -1;
+
+	return PoolHolder->GetNumberOfUsedInstances();
+}
+
 void AAPoolManager::InitializePools() {
 	DestroyAllPools();
+	bAllPoolsReady = false;
+
+	for (int32 i = 0; i < DesiredPools.Num(); i++) {
+		FSoftObjectPath ClassPath = DesiredPools[i].Class ? FSoftObjectPath(DesiredPools[i].Class) : DesiredPools[i].SoftClass.ToSoftObjectPath();
+		if (ClassPath.IsValid() && !ClassesToNetIndices.Contains(ClassPath)) {
+			ClassesToNetIndices.Add(ClassPath, i);
+		}
+	}
 
 	for (auto& PoolSpecification : DesiredPools) {
-		InitializeObjectPool(PoolSpecification);
+		if (PoolSpecification.Class) {
+			AddPool(PoolSpecification);
+		}
+		else if (!PoolSpecification.SoftClass.IsNull()) {
+			LoadPoolClass(PoolSpecification);
+		}
+		else {
+			UE_LOG(LogTemp, Error, TEXT("A desired pool has neither a class nor a soft class, it is ignored!"));
+		}
+	}
+
+	CheckAllPoolsReady();
+}
+
+void AAPoolManager::SetDesiredPools(const TArray<FPoolSpecification>& PoolSpecifications) {
+	DesiredPools = PoolSpecifications;
+}
+
+void AAPoolManager::AddPool(const FPoolSpecification& PoolSpecification) {
+	APoolHolder* PoolHolder = CreatePoolHolder(PoolSpecification, bWarmUpOverTime);
+	if (PoolHolder == nullptr) return;
+
+	if (bWarmUpOverTime) {
+		// Insert behind all pools with the same or a higher priority
+		int32 Index = 0;
+		while (Index < WarmingPools.Num() && (!IsValid(WarmingPools[Index]) || WarmingPools[Index]->GetSpecification().WarmUpPriority >= PoolSpecification.WarmUpPriority)) {
+			Index++;
+		}
+		WarmingPools.Insert(PoolHolder, Index);
+		SetActorTickEnabled(true);
+	}
+	else {
+		GetWorldTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &AAPoolManager::BroadcastPoolReady, TSubclassOf<UObject>(PoolSpecification.Class)));
 	}
 }
 
-void AAPoolManager::ReturnToPool(UObject* Object, const EEndPlayReason::Type EndPlayReason) {
+void AAPoolManager::LoadPoolClass(const FPoolSpecification& PoolSpecification) {
+	// Already loaded, e.g. by another pool or the level
+	if (PoolSpecification.SoftClass.Get()) {
+		FPoolSpecification LoadedPoolSpecification = PoolSpecification;
+		LoadedPoolSpecification.Class = PoolSpecification.SoftClass.Get();
+		AddPool(LoadedPoolSpecification);
+		return;
+	}
+
+	FSoftObjectPath ClassPath = PoolSpecification.SoftClass.ToSoftObjectPath();
+	if (LoadingPools.Contains(ClassPath)) {
+		UE_LOG(LogTemp, Warning, TEXT("The pool class %s is already loading for another pool, this pool specification is ignored!"), *ClassPath.ToString());
+		return;
+	}
+
+	TSharedPtr<FStreamableHandle> Handle = StreamableManager.RequestAsyncLoad(ClassPath, FStreamableDelegate::CreateUObject(this, &AAPoolManager::OnPoolClassLoaded, PoolSpecification));
+
+	// The delegate may already have been called if the load completed right away
+	if (Handle.IsValid() && Handle->IsLoadingInProgress()) {
+		LoadingPools.Add(ClassPath, Handle);
+	}
+}
+
+void AAPoolManager::OnPoolClassLoaded(FPoolSpecification PoolSpecification) {
+	LoadingPools.Remove(PoolSpecification.SoftClass.ToSoftObjectPath());
+
+	PoolSpecification.Class = PoolSpecification.SoftClass.Get();
+	if (PoolSpecification.Class) {
+		AddPool(PoolSpecification);
+	}
+	else {
+		UE_LOG(LogTemp, Error, TEXT("Couldn't load the pool class %s!"), *PoolSpecification.SoftClass.ToString());
+	}
+
+	CheckAllPoolsReady();
+}
+
+void AAPoolManager::CheckAllPoolsReady() {
+	if (WarmingPools.Num() > 0 || LoadingPools.Num() > 0) return;
+
+	SetActorTickEnabled(AsyncPools.Num() > 0);
+	GetWorldTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &AAPoolManager::BroadcastAllPoolsReady));
+}
+
+void AAPoolManager::BroadcastPoolReady(TSubclassOf<UObject> Class) {
+	OnPoolReady.Broadcast(Class);
+}
+
+void AAPoolManager::BroadcastAllPoolsReady() {
+	// A pool may have started loading in the meantime, it calls CheckAllPoolsReady again when it is done
+	if (WarmingPools.Num() > 0 || LoadingPools.Num() > 0) return;
+
+	bAllPoolsReady = true;
+	OnAllPoolsReady.Broadcast();
+}
+
+void AAPoolManager::WarmUpPools() {
+	double EndTime = FPlatformTime::Seconds() + WarmUpBudgetMs / 1000.0;
+
+	while (WarmingPools.Num() > 0 && FPlatformTime::Seconds() < EndTime) {
+		APoolHolder* PoolHolder = WarmingPools[0];
+
+		// The pool was emptied while it was warming up
+		if (!IsValid(PoolHolder)) {
+			WarmingPools.RemoveAt(0);
+			continue;
+		}
+
+		if (!PoolHolder->Fill(EndTime)) break;
+
+		WarmingPools.RemoveAt(0);
+		GetWorldTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &AAPoolManager::BroadcastPoolReady, TSubclassOf<UObject>(PoolHolder->GetPoolClass())));
+	}
+
+	CheckAllPoolsReady();
+}
+
+void AAPoolManager::ReturnToPool(const UObject* WorldContextObject, UObject* Object, const EEndPlayReason::Type EndPlayReason) {
 	APoolHolder* PoolHolder;
-	if (!GetPoolHolder(Object->GetClass(), PoolHolder)) return;
+	if (!GetPoolHolder(WorldContextObject, Object->GetClass(), PoolHolder)) return;
 	if (!IsValid(PoolHolder)) return;
 	PoolHolder->ReturnObject(Object, EndPlayReason);
 }
 
-void AAPoolManager::EmptyObjectPool(TSubclassOf<UObject> Class) {
+void AAPoolManager::ReturnMultipleToPool(const UObject* WorldContextObject, const TArray<UObject*>& Objects, const EEndPlayReason::Type EndPlayReason) {
+	if (Objects.Num() == 0) return;
+
+	// Bursts usually contain objects of a single class, so runs of the same class are returned together
+	TArray<UObject*, TInlineAllocator<128>> Run;
+	UClass* RunClass = nullptr;
+
+	auto ReturnRun = [&]() {
+		APoolHolder* PoolHolder;
+		if (Run.Num() > 0 && GetPoolHolder(WorldContextObject, RunClass, PoolHolder) && IsValid(PoolHolder)) {
+			PoolHolder->ReturnObjects(Run, EndPlayReason);
+		}
+		Run.Reset();
+	};
+
+	for (UObject* Object : Objects) {
+		if (!Object->IsValidLowLevelFast()) continue;
+
+		if (Object->GetClass() != RunClass) {
+			ReturnRun();
+			RunClass = Object->GetClass();
+		}
+		Run.Add(Object);
+	}
+	ReturnRun();
+}
+
+void AAPoolManager::EmptyObjectPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
 	if (Class) {
-		if (!IsValid(Instance)) return;
-		if (Instance->ClassNamesToPools.Num() == 0) return;
-		Instance->bIsReady = false;
+		AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+		if (!IsValid(PoolManager)) return;
+		if (PoolManager->ClassesToPools.Num() == 0) return;
 
-		APoolHolder* PoolHolder = *Instance->ClassNamesToPools.Find(*Class->GetName());
+		APoolHolder* PoolHolder = PoolManager->ClassesToPools.FindRef(Class);
 		if (!IsValid(PoolHolder)) return;
 
+		PoolManager->bIsReady = false;
+		if (PoolManager->PoolsByNetIndex.IsValidIndex(PoolHolder->GetPoolIndex())) {
+			PoolManager->PoolsByNetIndex[PoolHolder->GetPoolIndex()] = nullptr;
+		}
+		PoolManager->AsyncPools.Remove(PoolHolder);
 		PoolHolder->Destroy();
-		Instance->ClassNamesToPools.Remove(*Class->GetName());
-		Instance->bIsReady = true;
+		PoolManager->ClassesToPools.Remove(Class);
+		PoolManager->bIsReady = true;
 	}
 }
 
-void AAPoolManager::InitializeObjectPool(FPoolSpecification PoolSpecification) {
-	APoolHolder* PoolHolder = Instance->GetWorld()->SpawnActor<APoolHolder>(APoolHolder::StaticClass(), Instance->GetTransform());
-	PoolHolder->AttachToActor(Instance, FAttachmentTransformRules::KeepWorldTransform);
+void AAPoolManager::InitializeObjectPool(const UObject* WorldContextObject, FPoolSpecification PoolSpecification) {
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) {
+		UE_LOG(LogTemp, Error, TEXT("There is no pool manager in this world!"));
+		return;
+	}
+
+	if (!PoolSpecification.Class) {
+		if (PoolSpecification.SoftClass.IsNull()) {
+			UE_LOG(LogTemp, Error, TEXT("The pool specification has neither a class nor a soft class!"));
+			return;
+		}
+
+		// Not loaded yet, the pool is created asynchronously like the desired pools and announced by OnPoolReady
+		PoolSpecification.Class = PoolSpecification.SoftClass.Get();
+		if (!PoolSpecification.Class) {
+			PoolManager->LoadPoolClass(PoolSpecification);
+			return;
+		}
+	}
+
+	PoolManager->CreatePoolHolder(PoolSpecification, false);
+}
+
+APoolHolder* AAPoolManager::CreatePoolHolder(const FPoolSpecification& PoolSpecification, bool bDeferFill) {
+	// The soft class has to be resolved by the caller, the class is the key of the pool
+	if (!PoolSpecification.Class) {
+		UE_LOG(LogTemp, Error, TEXT("Can't create a pool without a class, resolve the soft class first!"));
+		return nullptr;
+	}
+
+	APoolHolder* PoolHolder = GetWorld()->SpawnActor<APoolHolder>(APoolHolder::StaticClass(), GetTransform());
+	PoolHolder->AttachToActor(this, FAttachmentTransformRules::KeepWorldTransform);
+
+	// Register the pool before filling it, so a warming pool can already hand out objects
+	ClassesToPools.Add(PoolSpecification.Class, PoolHolder);
+	AssignNetIndex(PoolHolder, PoolSpecification.Class);
+	PoolHolder->InitializePool(PoolSpecification, bDeferFill);
+
+	if (PoolHolder->GetAsyncQueue().IsValid()) {
+		AsyncPools.Add(PoolHolder);
+		SetActorTickEnabled(true);
+	}
+
+	return PoolHolder;
+}
+
+void AAPoolManager::AssignNetIndex(APoolHolder* PoolHolder, UClass* Class) {
+	FSoftObjectPath ClassPath(Class);
+
+	// Pools created at runtime are numbered after the DesiredPools in the order of their creation
+	int32 NetIndex;
+	int32* FoundNetIndex = ClassesToNetIndices.Find(ClassPath);
+	if (FoundNetIndex != nullptr) {
+		NetIndex = *FoundNetIndex;
+	}
+	else {
+		NetIndex = FMath::Max(DesiredPools.Num(), PoolsByNetIndex.Num());
+		ClassesToNetIndices.Add(ClassPath, NetIndex);
+	}
+
+	if (NetIndex > PoolNetId::MaxPoolIndex) {
+		UE_LOG(LogTemp, Error, TEXT("Too many pools, the objects of %s can't be identified by network ids!"), *Class->GetName());
+		return;
+	}
 
-	PoolHolder->InitializePool(PoolSpecification);
-	Instance->ClassNamesToPools.Add(PoolSpecification.Class->GetName(), PoolHolder);
+	if (PoolsByNetIndex.Num() <= NetIndex) {
+		PoolsByNetIndex.SetNumZeroed(NetIndex + 1);
+	}
+	PoolsByNetIndex[NetIndex] = PoolHolder;
+	PoolHolder->SetPoolIndex(NetIndex);
 }
 
 FString AAPoolManager::GetObjectName(UObject* Object) {
@@ -179,55 +571,144 @@ FString AAPoolManager::GetObjectName(UObject* Object) {
 	return Name;
 }
 
-int32 AAPoolManager::GetNumberOfUsedObjects(TSubclassOf<UObject> Class) {
+int32 AAPoolManager::GetNetId(const UObject* WorldContextObject, UObject* Object) {
+	if (!IsValid(Object)) return INDEX_NONE;
+
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) return INDEX_NONE;
+
+	APoolHolder* PoolHolder = PoolManager->ClassesToPools.FindRef(Object->GetClass());
+	if (!IsValid(PoolHolder)) return INDEX_NONE;
+
+	return PoolHolder->GetNetId(Object);
+}
+
+UObject* AAPoolManager::GetObjectByNetId(const UObject* WorldContextObject, int32 NetId) {
+	APoolHolder* PoolHolder = GetPoolHolderByNetId(WorldContextObject, NetId);
+	if (PoolHolder == nullptr) return nullptr;
+
+	UObject* Object = PoolHolder->GetObjectBySlot(PoolNetId::GetSlotHandle(NetId));
+	return IsValid(Object) ? Object : nullptr;
+}
+
+APoolHolder* AAPoolManager::GetPoolHolderByNetId(const UObject* WorldContextObject, int32 NetId) {
+	if (NetId < 0) return nullptr;
+
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) return nullptr;
+
+	int32 NetIndex = PoolNetId::GetPoolIndex(NetId);
+	if (!PoolManager->PoolsByNetIndex.IsValidIndex(NetIndex)) return nullptr;
+
+	APoolHolder* PoolHolder = PoolManager->PoolsByNetIndex[NetIndex];
+	return IsValid(PoolHolder) ? PoolHolder : nullptr;
+}
+
+int32 AAPoolManager::GetNumberOfUsedObjects(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
 	APoolHolder* PoolHolder;
-	if (!GetPoolHolder(Class, PoolHolder)) return -1;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder)) return -1;
 	if (!IsValid(PoolHolder)) return -1;
 
 	return PoolHolder->GetNumberOfUsedObjects();
 }
 
-int32 AAPoolManager::GetNumberOfAvailableObjects(TSubclassOf<UObject> Class) {
+int32 AAPoolManager::GetNumberOfAvailableObjects(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
 	APoolHolder* PoolHolder;
-	if (!GetPoolHolder(Class, PoolHolder)) return -1;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder)) return -1;
 	if (!IsValid(PoolHolder)) return -1;
 
 	return PoolHolder->GetNumberOfAvailableObjects();
 }
 
-bool AAPoolManager::IsObjectActive(UObject* Object) {
-	AActor* Actor = Cast<AActor>(Object);
-	if (Actor->IsValidLowLevelFast()) {
-		AActor* AttachedTo = Actor->GetAttachParentActor();
-		if (AttachedTo->IsValidLowLevelFast()) {
-			return AttachedTo->GetClass()->IsChildOf(APoolHolder::StaticClass());
-		}
-	}
-	else {
-		APoolHolder* PoolHolder;
-		if (GetPoolHolder(Object->GetClass(), PoolHolder)) {
-			if (PoolHolder->IsValidLowLevelFast()) {
-				return !PoolHolder->IsObjectAvailable(Object);
-			}
+int32 AAPoolManager::GetHighWaterMark(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
+	APoolHolder* PoolHolder;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder)) return -1;
+	if (!IsValid(PoolHolder)) return -1;
+
+	return PoolHolder->GetHighWaterMark();
+}
+
+bool AAPoolManager::GetPoolMetrics(const UObject* WorldContextObject, TSubclassOf<UObject> Class, FPoolMetrics& Metrics) {
+	APoolHolder* PoolHolder;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder)) return false;
+	if (!IsValid(PoolHolder)) return false;
+
+	Metrics = PoolHolder->GetMetrics();
+	return true;
+}
+
+bool AAPoolManager::IsObjectActive(const UObject* WorldContextObject, UObject* Object) {
+	if (!Object->IsValidLowLevelFast()) return false;
+
+	// Parked actors aren't attached to their pool, so ask the pool itself
+	APoolHolder* PoolHolder;
+	if (GetPoolHolder(WorldContextObject, Object->GetClass(), PoolHolder)) {
+		if (PoolHolder->IsValidLowLevelFast()) {
+			return !PoolHolder->IsObjectAvailable(Object);
 		}
 	}
 
 	return false;
 }
 
-bool AAPoolManager::ContainsClass(TSubclassOf<UObject> Class) {
+bool AAPoolManager::ContainsClass(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
 	if (!Class) return false;
-	FString Key = Class->GetName();
-	return Instance->ClassNamesToPools.Contains(Key);
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) return false;
+	return PoolManager->ClassesToPools.Contains(Class);
+}
+
+bool AAPoolManager::IsPoolReady(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
+	if (!Class) return false;
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) return false;
+
+	APoolHolder* PoolHolder = PoolManager->ClassesToPools.FindRef(Class);
+	if (!IsValid(PoolHolder)) return false;
+
+	return PoolHolder->IsFilled();
+}
+
+TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> AAPoolManager::GetAsyncQueue(const UObject* WorldContextObject, TSubclassOf<UObject> Class) {
+	APoolHolder* PoolHolder;
+	if (!GetPoolHolder(WorldContextObject, Class, PoolHolder)) return nullptr;
+	if (!IsValid(PoolHolder)) return nullptr;
+
+	if (!PoolHolder->GetAsyncQueue().IsValid()) {
+		UE_LOG(LogTemp, Error, TEXT("The pool of %s has no async reservations!"), *Class->GetName());
+	}
+
+	return PoolHolder->GetAsyncQueue();
+}
+
+bool AAPoolManager::IsPoolLoading(const UObject* WorldContextObject, TSoftClassPtr<UObject> SoftClass) {
+	if (SoftClass.IsNull()) return false;
+	AAPoolManager* PoolManager = GetPoolManager(WorldContextObject);
+	if (!IsValid(PoolManager)) return false;
+	if (PoolManager->LoadingPools.Num() == 0) return false;
+
+	return PoolManager->LoadingPools.Contains(SoftClass.ToSoftObjectPath());
 }
 
 void AAPoolManager::DestroyAllPools() {
 	TArray<APoolHolder*> Pools;
-	ClassNamesToPools.GenerateValueArray(Pools);
+	ClassesToPools.GenerateValueArray(Pools);
 
 	for (auto& PoolHolder : Pools) {
 		PoolHolder->Destroy();
 	}
+	ClassesToPools.Empty();
+	WarmingPools.Empty();
+	AsyncPools.Empty();
+	PoolsByNetIndex.Empty();
+	ClassesToNetIndices.Empty();
+
+	for (auto& LoadingPool : LoadingPools) {
+		if (LoadingPool.Value.IsValid()) {
+			LoadingPool.Value->CancelHandle();
+		}
+	}
+	LoadingPools.Empty();
 
 	TArray<AActor*> AttachedActors;
 	GetAttachedActors(AttachedActors);
@@ -236,10 +717,9 @@ void AAPoolManager::DestroyAllPools() {
 	}
 }
 
-bool AAPoolManager::IsPoolManagerReady() {
-	if (!IsValid(Instance)) return false;
-	if (Instance->ClassNamesToPools.Num() == 0) return false;
-	if (!Instance->bIsReady) return false;
+bool AAPoolManager::IsPoolManagerReady() const {
+	if (ClassesToPools.Num() == 0 && LoadingPools.Num() == 0) return false;
+	if (!bIsReady) return false;
 
 	return true;
 }
\ No newline at end of file
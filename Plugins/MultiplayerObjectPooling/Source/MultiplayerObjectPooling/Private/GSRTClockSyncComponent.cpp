@@ -0,0 +1,156 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "GSRTClockSyncComponent.h"
+
+static double Median(TArray<double>& Values) {
+	Values.Sort();
+	int32 Middle = Values.Num() / 2;
+
+	return Values.Num() % 2 == 1 ? Values[Middle] : (Values[Middle - 1] + Values[Middle]) * 0.5;
+}
+
+UGSRTClockSyncComponent::UGSRTClockSyncComponent()
+{
+	// Only ticks to request new samples, quickly until the clock is synchronized
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickInterval = 0.1f;
+
+	SyncInterval = 2.f;
+	InitialSamples = 5;
+	SnapThresholdMs = 250.f;
+	MaxCorrectionMsPerSecond = 5.f;
+
+	RoundTripTime = 0.f;
+	TargetOffset = 0.0;
+	ReferenceTime = 0.0;
+	Drift = 0.0;
+	PreviousOffset = 0.0;
+	CorrectionStartTime = 0.0;
+	bIsSynchronized = false;
+}
+
+void UGSRTClockSyncComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) {
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	OnSyncRequest.Broadcast(GetLocalTime());
+}
+
+void UGSRTClockSyncComponent::AddSample(int64 ClientTime, int64 ServerTime) {
+	double LocalTime = GetLocalTimePrecise();
+
+	FGSRTClockSample Sample;
+	Sample.LocalTime = LocalTime;
+	Sample.RoundTripTime = FMath::Max(LocalTime - ClientTime, 0.0);
+	// The server answered roughly in the middle of the round trip
+	Sample.Offset = ServerTime - (ClientTime + Sample.RoundTripTime * 0.5);
+
+	if (Samples.Num() >= MaxSamples) {
+		Samples.RemoveAt(0, 1, false);
+	}
+	Samples.Add(Sample);
+
+	Estimate();
+
+	if (!bIsSynchronized && Samples.Num() >= InitialSamples) {
+		bIsSynchronized = true;
+		SetComponentTickInterval(SyncInterval);
+	}
+}
+
+int64 UGSRTClockSyncComponent::GetServerTime() const {
+	return (int64)GetServerTimePrecise();
+}
+
+int64 UGSRTClockSyncComponent::GetLocalTime() const {
+	return (int64)GetLocalTimePrecise();
+}
+
+float UGSRTClockSyncComponent::GetRoundTripTime() const {
+	return RoundTripTime;
+}
+
+bool UGSRTClockSyncComponent::IsSynchronized() const {
+	return bIsSynchronized;
+}
+
+double UGSRTClockSyncComponent::GetServerTimePrecise() const {
+	double LocalTime = GetLocalTimePrecise();
+
+	return LocalTime + GetOffset(LocalTime);
+}
+
+double UGSRTClockSyncComponent::GetLocalTimePrecise() const {
+	// Monotonic, unlike the system time it can't jump
+	return FPlatformTime::Seconds() * 1000.0;
+}
+
+double UGSRTClockSyncComponent::GetTargetOffset(double LocalTime) const {
+	return TargetOffset + Drift * (LocalTime - ReferenceTime);
+}
+
+double UGSRTClockSyncComponent::GetOffset(double LocalTime) const {
+	double Target = GetTargetOffset(LocalTime);
+	double MaxCorrection = MaxCorrectionMsPerSecond * (LocalTime - CorrectionStartTime) / 1000.0;
+
+	return PreviousOffset + FMath::Clamp(Target - PreviousOffset, -MaxCorrection, MaxCorrection);
+}
+
+void UGSRTClockSyncComponent::Estimate() {
+	double LocalTime = GetLocalTimePrecise();
+	double CurrentOffset = GetOffset(LocalTime);
+
+	TArray<double> RoundTripTimes;
+	for (auto& Sample : Samples) {
+		RoundTripTimes.Add(Sample.RoundTripTime);
+	}
+	double MedianRoundTripTime = Median(RoundTripTimes);
+	RoundTripTime = (float)MedianRoundTripTime;
+
+	// Long round trips were probably delayed in one direction only, their offset is unreliable
+	TArray<const FGSRTClockSample*> Accepted;
+	for (auto& Sample : Samples) {
+		if (Sample.RoundTripTime <= MedianRoundTripTime * 1.5 + 1.0) {
+			Accepted.Add(&Sample);
+		}
+	}
+
+	TArray<double> Offsets;
+	double MeanTime = 0.0;
+	double MeanOffset = 0.0;
+	for (auto Sample : Accepted) {
+		Offsets.Add(Sample->Offset);
+		MeanTime += Sample->LocalTime;
+		MeanOffset += Sample->Offset;
+	}
+	MeanTime /= Accepted.Num();
+	MeanOffset /= Accepted.Num();
+
+	// The drift needs samples spread over some seconds, otherwise the jitter dominates the fit
+	double TimeSpan = Accepted.Last()->LocalTime - Accepted[0]->LocalTime;
+	if (Accepted.Num() >= 4 && TimeSpan > 5000.0) {
+		double Covariance = 0.0;
+		double Variance = 0.0;
+		for (auto Sample : Accepted) {
+			Covariance += (Sample->LocalTime - MeanTime) * (Sample->Offset - MeanOffset);
+			Variance += FMath::Square(Sample->LocalTime - MeanTime);
+		}
+
+		Drift = Variance > 0.0 ? Covariance / Variance : 0.0;
+		TargetOffset = MeanOffset;
+		ReferenceTime = MeanTime;
+	}
+	else {
+		Drift = 0.0;
+		TargetOffset = Median(Offsets);
+		ReferenceTime = LocalTime;
+	}
+
+	// The first estimate and large errors are applied at once
+	if (Samples.Num() == 1 || FMath::Abs(GetTargetOffset(LocalTime) - CurrentOffset) > SnapThresholdMs) {
+		PreviousOffset = GetTargetOffset(LocalTime);
+	}
+	else {
+		PreviousOffset = CurrentOffset;
+	}
+	CorrectionStartTime = LocalTime;
+}
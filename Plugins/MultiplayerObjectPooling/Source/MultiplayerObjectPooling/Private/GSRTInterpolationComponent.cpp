@@ -0,0 +1,135 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "GSRTInterpolationComponent.h"
+#include "GSRTClockSyncComponent.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+
+UGSRTInterpolationComponent::UGSRTInterpolationComponent()
+{
+	// Only ticks while there are snapshots to move along
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	ClockSync = nullptr;
+	InterpolationDelayMs = 100.f;
+	MaxExtrapolationMs = 250.f;
+}
+
+void UGSRTInterpolationComponent::AddSnapshot(int64 ServerTime, const FTransform& Transform) {
+	FGSRTTransformSnapshot Snapshot;
+	Snapshot.Time = (double)ServerTime;
+	Snapshot.Transform = Transform;
+
+	// Unreliable packets may arrive out of order, keep the buffer sorted
+	int32 Index = Snapshots.Num();
+	while (Index > 0 && Snapshots[Index - 1].Time > Snapshot.Time) {
+		Index--;
+	}
+	if (Index > 0 && Snapshots[Index - 1].Time == Snapshot.Time) return;
+
+	// A snapshot older than the whole full buffer is useless
+	if (Snapshots.Num() >= MaxSnapshots) {
+		if (Index == 0) return;
+
+		Snapshots.RemoveAt(0, 1, false);
+		Index--;
+	}
+	Snapshots.Insert(Snapshot, Index);
+
+	SetComponentTickEnabled(true);
+}
+
+void UGSRTInterpolationComponent::ClearSnapshots() {
+	Snapshots.Empty();
+	SetComponentTickEnabled(false);
+}
+
+void UGSRTInterpolationComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) {
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	AActor* Owner = GetOwner();
+	UGSRTClockSyncComponent* Clock = FindClockSync();
+	if (Owner == nullptr || Clock == nullptr) return;
+
+	double RenderTime = Clock->GetServerTimePrecise() - InterpolationDelayMs;
+
+	FTransform Transform;
+	if (SampleTransform(RenderTime, Transform)) {
+		Owner->SetActorTransform(Transform, false, nullptr, ETeleportType::None);
+	}
+
+	// Keep a single snapshot older than the render time as start of the interpolation, and two for the extrapolation
+	int32 NumberOfOldSnapshots = 0;
+	while (NumberOfOldSnapshots + 2 < Snapshots.Num() && Snapshots[NumberOfOldSnapshots + 1].Time <= RenderTime) {
+		NumberOfOldSnapshots++;
+	}
+	if (NumberOfOldSnapshots > 0) {
+		Snapshots.RemoveAt(0, NumberOfOldSnapshots, false);
+	}
+
+	// The actor stays where the extrapolation ended, AddSnapshot enables the tick again
+	if (Snapshots.Num() > 0 && RenderTime > Snapshots.Last().Time + MaxExtrapolationMs) {
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UGSRTInterpolationComponent::PoolableBeginPlay_Implementation() {
+}
+
+void UGSRTInterpolationComponent::PoolableEndPlay_Implementation(const EEndPlayReason::Type EndPlayReason) {
+	// The next user of the pooled actor must not move along the old path
+	ClearSnapshots();
+}
+
+UGSRTClockSyncComponent* UGSRTInterpolationComponent::FindClockSync() {
+	if (IsValid(ClockSync)) return ClockSync;
+
+	UWorld* World = GetWorld();
+	if (World == nullptr) return nullptr;
+
+	APlayerController* PlayerController = World->GetFirstPlayerController();
+	if (PlayerController != nullptr) {
+		ClockSync = PlayerController->FindComponentByClass<UGSRTClockSyncComponent>();
+	}
+
+	if (ClockSync == nullptr && World->GetGameState() != nullptr) {
+		ClockSync = World->GetGameState()->FindComponentByClass<UGSRTClockSyncComponent>();
+	}
+
+	return ClockSync;
+}
+
+bool UGSRTInterpolationComponent::SampleTransform(double Time, FTransform& Transform) {
+	if (Snapshots.Num() == 0) return false;
+
+	const FGSRTTransformSnapshot& Oldest = Snapshots[0];
+	if (Time <= Oldest.Time || Snapshots.Num() == 1) {
+		Transform = Oldest.Transform;
+		return true;
+	}
+
+	for (int32 i = 1; i < Snapshots.Num(); i++) {
+		if (Snapshots[i].Time >= Time) {
+			const FGSRTTransformSnapshot& From = Snapshots[i - 1];
+			const FGSRTTransformSnapshot& To = Snapshots[i];
+			float Alpha = (float)((Time - From.Time) / (To.Time - From.Time));
+
+			Transform.Blend(From.Transform, To.Transform, Alpha);
+			return true;
+		}
+	}
+
+	// The newer snapshots are missing, continue the last movement for a short time
+	const FGSRTTransformSnapshot& Previous = Snapshots[Snapshots.Num() - 2];
+	const FGSRTTransformSnapshot& Newest = Snapshots.Last();
+	double ExtrapolationTime = FMath::Min(Time - Newest.Time, (double)MaxExtrapolationMs);
+	float Alpha = (float)(1.0 + ExtrapolationTime / (Newest.Time - Previous.Time));
+
+	Transform = Newest.Transform;
+	Transform.SetLocation(FMath::Lerp(Previous.Transform.GetLocation(), Newest.Transform.GetLocation(), Alpha));
+	Transform.SetRotation(FQuat::Slerp(Previous.Transform.GetRotation(), Newest.Transform.GetRotation(), Alpha));
+	return true;
+}
@@ -0,0 +1,453 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "GSRTLoadTestCommandlet.h"
+#include "Engine.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Dom/JsonObject.h"
+#include "GSRTLoopbackRelay.h"
+#include "GSRTSendQueueComponent.h"
+#include "GSRTUtilities.h"
+#include "PoolBenchmark.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGSRTLoadTest, Log, All);
+
+// Distance between the centers of two peers, larger than the relevancy cells of the relay
+static const float PeerSpacing = 8000.f;
+
+struct FLoadTestPeer {
+	int32 PeerId = 0;
+	FVector Center = FVector::ZeroVector;
+	// Owned actors, nullptr if the pool couldn't spawn one
+	TArray<AActor*> Actors;
+	// Sequences of the movement of every owned actor
+	TArray<FGSRTSequenceChannel> MovementChannels;
+	// Newest received movement of every remote actor by its net id
+	TMap<int32, FGSRTSequenceChannel> ReceivedChannels;
+	double SpawnBudget = 0.0;
+	double LastClockSync = -1000000.0;
+};
+
+struct FLoadTestResults {
+	TArray<double> Latencies;
+	TArray<double> RoundTripTimes;
+	int64 MovementsApplied = 0;
+	int64 StaleMovements = 0;
+	int64 UnknownNetIds = 0;
+	int64 MalformedPackets = 0;
+	int64 SpawnEvents = 0;
+	int64 ServerTimePackets = 0;
+};
+
+// Movement message of one actor with a location in whole centimeters
+static void SerializeMovement(FArchive& Ar, int32& NetId, uint16& Sequence, FVector& Location) {
+	uint32 PackedNetId = (uint32)NetId;
+	Ar.SerializeIntPacked(PackedNetId);
+	NetId = (int32)PackedNetId;
+
+	Ar << Sequence;
+
+	for (int32 Axis = 0; Axis < 3; Axis++) {
+		int32 Quantized = FMath::RoundToInt(Location[Axis]);
+		UGSRTUtilities::SerializeZigZag(Ar, Quantized);
+		Location[Axis] = (float)Quantized;
+	}
+}
+
+static AActor* SpawnLoadTestActor(UWorld* World, const FVector& Location) {
+	EBranch Branch;
+	return AAPoolManager::SpawnActorFromPool(World, APoolBenchmarkActor::StaticClass(), FTransform(Location), nullptr, nullptr, Branch);
+}
+
+static void SendSpawnEvent(FGSRTLoopbackRelay& Relay, int32 PeerId, int32 NetId, bool bSpawned, double Now) {
+	FGSRTRelayPacket Packet;
+	Packet.OpCode = GSRTOpCode::Default;
+	Packet.Sender = PeerId;
+	Packet.Data = MakeShared<FGSRTRelayData>();
+	Packet.Data->Longs.Add(1, NetId);
+	Packet.Data->Longs.Add(2, bSpawned ? 1 : 0);
+	Packet.SendTime = Now;
+
+	Relay.Send(Packet, Now);
+}
+
+// Tag a movement packet for the relevancy filter of the relay, only one packet per tick needs to carry the position
+static void TagRelevancy(FGSRTRelayData& Data, const FVector* PlayerLocation, bool bRelevancy) {
+	if (bRelevancy) {
+		Data.Longs.Add(GSRTOpCode::RelevancyKey, (int64)EGSRTRelevancy::Spatial);
+	}
+	if (PlayerLocation != nullptr) {
+		Data.Floats.Add(GSRTOpCode::PositionKey, PlayerLocation->X);
+		Data.Floats.Add(GSRTOpCode::PositionKey + 1, PlayerLocation->Y);
+	}
+}
+
+static void ApplyMovement(UWorld* World, FLoadTestPeer& Peer, int32 SenderPeerId, const TArray<uint8>& Message, FLoadTestResults& Results) {
+	int32 NetId = INDEX_NONE;
+	uint16 Sequence = 0;
+	FVector Location;
+
+	FBitReader Reader(const_cast<uint8*>(Message.GetData()), Message.Num() * 8);
+	SerializeMovement(Reader, NetId, Sequence, Location);
+	if (Reader.IsError()) {
+		Results.MalformedPackets++;
+		return;
+	}
+
+	if (!UGSRTUtilities::AcceptSequence(Peer.ReceivedChannels.FindOrAdd(NetId), SenderPeerId, Sequence)) {
+		Results.StaleMovements++;
+		return;
+	}
+
+	// All peers share one world, so the lookup stands in for moving the proxy of the remote actor
+	if (AAPoolManager::GetObjectByNetId(World, NetId) == nullptr) {
+		Results.UnknownNetIds++;
+		return;
+	}
+	Results.MovementsApplied++;
+}
+
+static void ReceivePacket(UWorld* World, FLoadTestPeer& Peer, const FGSRTRelayPacket& Packet, double Now, FLoadTestResults& Results) {
+	if (!Packet.Data.IsValid()) return;
+
+	switch (Packet.OpCode) {
+	case GSRTOpCode::Default: {
+		Results.Latencies.Add(Now - Packet.SendTime);
+		Results.SpawnEvents++;
+
+		TSharedPtr<FGSRTRelayData>* Wrapped = Packet.Data->Data.Find(GSRTOpCode::WrapperPacketCode);
+		const int64* NetId = Wrapped != nullptr && Wrapped->IsValid() ? (*Wrapped)->Longs.Find(1) : nullptr;
+		const int64* bSpawned = Wrapped != nullptr && Wrapped->IsValid() ? (*Wrapped)->Longs.Find(2) : nullptr;
+		if (NetId == nullptr || bSpawned == nullptr) {
+			Results.MalformedPackets++;
+		}
+		else if (*bSpawned != 0 && AAPoolManager::GetObjectByNetId(World, (int32)*NetId) == nullptr) {
+			Results.UnknownNetIds++;
+		}
+		break;
+	}
+	case GSRTOpCode::UnreliableSequenced: {
+		Results.Latencies.Add(Now - Packet.SendTime);
+
+		TSharedPtr<FGSRTRelayData>* Wrapped = Packet.Data->Data.Find(GSRTOpCode::WrapperPacketCode);
+		const TArray<uint8>* Message = Wrapped != nullptr && Wrapped->IsValid() ? (*Wrapped)->Bytes.Find(1) : nullptr;
+		if (Message == nullptr) {
+			Results.MalformedPackets++;
+			break;
+		}
+
+		ApplyMovement(World, Peer, Packet.Sender, *Message, Results);
+		break;
+	}
+	case GSRTOpCode::Batch: {
+		Results.Latencies.Add(Now - Packet.SendTime);
+
+		TArray<FGSRTMessage> Messages;
+		const TArray<uint8>* Batch = Packet.Data->Bytes.Find(1);
+		if (Batch == nullptr || !UGSRTSendQueueComponent::SplitBatch(*Batch, Messages)) {
+			Results.MalformedPackets++;
+			break;
+		}
+
+		for (auto& Message : Messages) {
+			ApplyMovement(World, Peer, Packet.Sender, Message.Data, Results);
+		}
+		break;
+	}
+	case GSRTOpCode::ClockSync: {
+		const int64* ClientTime = Packet.Data->Longs.Find(3);
+		if (ClientTime != nullptr) {
+			Results.RoundTripTimes.Add(Now - *ClientTime);
+		}
+		break;
+	}
+	case GSRTOpCode::ServerTime:
+		Results.ServerTimePackets++;
+		break;
+	}
+}
+
+static double Mean(const TArray<double>& Values) {
+	if (Values.Num() == 0) return 0.0;
+
+	double Total = 0.0;
+	for (double Value : Values) {
+		Total += Value;
+	}
+
+	return Total / Values.Num();
+}
+
+static TSharedRef<FJsonObject> MakeLatencyJson(TArray<double>& Latencies) {
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	if (Latencies.Num() == 0) return Json;
+
+	Latencies.Sort();
+	auto Percentile = [&Latencies](double Fraction) { return Latencies[FMath::Min(Latencies.Num() - 1, (int32)(Latencies.Num() * Fraction))]; };
+
+	Json->SetNumberField(TEXT("meanMs"), Mean(Latencies));
+	Json->SetNumberField(TEXT("p50Ms"), Percentile(0.5));
+	Json->SetNumberField(TEXT("p99Ms"), Percentile(0.99));
+	Json->SetNumberField(TEXT("maxMs"), Latencies.Last());
+
+	return Json;
+}
+
+UGSRTLoadTestCommandlet::UGSRTLoadTestCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UGSRTLoadTestCommandlet::Main(const FString& Params) {
+	int32 NumberOfPeers = 8;
+	FParse::Value(*Params, TEXT("Peers="), NumberOfPeers);
+	NumberOfPeers = FMath::Max(NumberOfPeers, 2);
+
+	int32 ActorsPerPeer = 50;
+	FParse::Value(*Params, TEXT("ActorsPerPeer="), ActorsPerPeer);
+	ActorsPerPeer = FMath::Max(ActorsPerPeer, 1);
+
+	float Seconds = 10.f;
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+
+	int32 TickRate = 30;
+	FParse::Value(*Params, TEXT("TickRate="), TickRate);
+	TickRate = FMath::Max(TickRate, 1);
+
+	float LatencyMs = 50.f;
+	FParse::Value(*Params, TEXT("LatencyMs="), LatencyMs);
+
+	float JitterMs = 0.f;
+	FParse::Value(*Params, TEXT("JitterMs="), JitterMs);
+	JitterMs = FMath::Max(JitterMs, 0.f);
+
+	float PacketLoss = 0.02f;
+	FParse::Value(*Params, TEXT("Loss="), PacketLoss);
+
+	// Respawned actors per peer and second
+	float SpawnRate = 5.f;
+	FParse::Value(*Params, TEXT("SpawnRate="), SpawnRate);
+
+	int32 Seed = 1;
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+
+	bool bBatch = FParse::Param(*Params, TEXT("Batch"));
+	bool bRelevancy = FParse::Param(*Params, TEXT("Relevancy"));
+
+	FString OutputFile = FPaths::ProjectSavedDir() / TEXT("GSRTLoadTest") / TEXT("GSRTLoadTest.json");
+	FParse::Value(*Params, TEXT("Output="), OutputFile);
+
+	double FrameMs = 1000.0 / TickRate;
+	int32 NumberOfFrames = FMath::Max(FMath::CeilToInt(Seconds * TickRate), 1);
+	double SimulatedSeconds = NumberOfFrames * FrameMs / 1000.0;
+
+	FGSRTLoopbackRelay Relay(LatencyMs, JitterMs, PacketLoss, Seed);
+	FRandomStream Random(Seed);
+	FLoadTestResults Results;
+	FPoolMetrics Metrics;
+	double WallSeconds = 0.0;
+
+	{
+		FPoolBenchmarkWorld BenchmarkWorld;
+		UWorld* World = BenchmarkWorld.GetWorld();
+
+		// Headroom for the actors which are respawned while the old ones are still in use
+		FPoolSpecification PoolSpecification;
+		PoolSpecification.Class = APoolBenchmarkActor::StaticClass();
+		PoolSpecification.NumberOfObjects = NumberOfPeers * ActorsPerPeer + NumberOfPeers * 4;
+		PoolSpecification.GrowthPolicy = EPoolGrowthPolicy::ByCount;
+		PoolSpecification.GrowthCount = NumberOfPeers * 4;
+		BenchmarkWorld.GetPoolManager()->InitializeBenchmarkPools({ PoolSpecification });
+
+		TArray<FLoadTestPeer> Peers;
+		Peers.SetNum(NumberOfPeers);
+		for (int32 i = 0; i < NumberOfPeers; i++) {
+			FLoadTestPeer& Peer = Peers[i];
+			Peer.PeerId = i + 1;
+			Peer.Center = FVector((i % 4) * PeerSpacing, (i / 4) * PeerSpacing, 0.f);
+			Relay.Connect(Peer.PeerId);
+
+			for (int32 j = 0; j < ActorsPerPeer; j++) {
+				AActor* Actor = SpawnLoadTestActor(World, Peer.Center);
+				Peer.Actors.Add(Actor);
+				Peer.MovementChannels.AddDefaulted();
+
+				if (Actor != nullptr) {
+					SendSpawnEvent(Relay, Peer.PeerId, AAPoolManager::GetNetId(World, Actor), true, 0.0);
+				}
+			}
+		}
+
+		UE_LOG(LogGSRTLoadTest, Display, TEXT("Simulating %d peers with %d actors each for %.1f seconds"), NumberOfPeers, ActorsPerPeer, SimulatedSeconds);
+
+		TArray<FGSRTRelayPacket> ReceivedPackets;
+		double StartTime = FPlatformTime::Seconds();
+
+		for (int32 Frame = 0; Frame < NumberOfFrames; Frame++) {
+			double Now = Frame * FrameMs;
+
+			for (FLoadTestPeer& Peer : Peers) {
+				// Return some actors to the pool and spawn new ones
+				Peer.SpawnBudget += SpawnRate * FrameMs / 1000.0;
+				while (Peer.SpawnBudget >= 1.0) {
+					Peer.SpawnBudget -= 1.0;
+
+					AActor*& Actor = Peer.Actors[Random.RandHelper(Peer.Actors.Num())];
+					if (Actor != nullptr) {
+						SendSpawnEvent(Relay, Peer.PeerId, AAPoolManager::GetNetId(World, Actor), false, Now);
+						AAPoolManager::ReturnToPool(World, Actor);
+					}
+
+					Actor = SpawnLoadTestActor(World, Peer.Center);
+					if (Actor != nullptr) {
+						SendSpawnEvent(Relay, Peer.PeerId, AAPoolManager::GetNetId(World, Actor), true, Now);
+					}
+				}
+
+				TArray<uint8> Batch;
+				FVector PlayerLocation = Peer.Center;
+				for (int32 i = 0; i < Peer.Actors.Num(); i++) {
+					AActor* Actor = Peer.Actors[i];
+					if (Actor == nullptr) continue;
+
+					// Circles of different sizes around the center of the peer
+					float Angle = (float)(Now / 1000.0) * 0.5f + i * 0.37f;
+					FVector Location = Peer.Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * (500.f + 20.f * i);
+					Actor->SetActorLocation(Location);
+					if (i == 0) {
+						PlayerLocation = Location;
+					}
+
+					int32 NetId = AAPoolManager::GetNetId(World, Actor);
+					uint16 Sequence = (uint16)UGSRTUtilities::NextSequence(Peer.MovementChannels[i]);
+
+					FBitWriter Writer(0, true);
+					SerializeMovement(Writer, NetId, Sequence, Location);
+					TArray<uint8> Message(Writer.GetData(), Writer.GetNumBytes());
+
+					if (bBatch) {
+						UGSRTSendQueueComponent::AppendMessage(Batch, Message);
+						continue;
+					}
+
+					FGSRTRelayPacket Packet;
+					Packet.OpCode = GSRTOpCode::UnreliableSequenced;
+					Packet.Sender = Peer.PeerId;
+					Packet.bReliable = false;
+					Packet.Data = MakeShared<FGSRTRelayData>();
+					Packet.Data->Bytes.Add(1, MoveTemp(Message));
+					Packet.SendTime = Now;
+					TagRelevancy(*Packet.Data, i == 0 ? &PlayerLocation : nullptr, bRelevancy);
+
+					Relay.Send(Packet, Now);
+				}
+
+				if (Batch.Num() > 0) {
+					FGSRTRelayPacket Packet;
+					Packet.OpCode = GSRTOpCode::Batch;
+					Packet.Sender = Peer.PeerId;
+					Packet.Data = MakeShared<FGSRTRelayData>();
+					Packet.Data->Bytes.Add(1, MoveTemp(Batch));
+					Packet.SendTime = Now;
+					TagRelevancy(*Packet.Data, &PlayerLocation, bRelevancy);
+
+					Relay.Send(Packet, Now);
+				}
+
+				if (Now - Peer.LastClockSync >= 1000.0) {
+					Peer.LastClockSync = Now;
+
+					FGSRTRelayPacket Packet;
+					Packet.OpCode = GSRTOpCode::ClockSync;
+					Packet.Sender = Peer.PeerId;
+					Packet.Data = MakeShared<FGSRTRelayData>();
+					Packet.Data->Longs.Add(3, (int64)Now);
+					Packet.SendTime = Now;
+
+					Relay.Send(Packet, Now);
+				}
+			}
+
+			Relay.Tick(Now);
+
+			for (FLoadTestPeer& Peer : Peers) {
+				ReceivedPackets.Reset();
+				Relay.Receive(Peer.PeerId, ReceivedPackets);
+
+				for (auto& Packet : ReceivedPackets) {
+					ReceivePacket(World, Peer, Packet, Now, Results);
+				}
+			}
+		}
+
+		WallSeconds = FPlatformTime::Seconds() - StartTime;
+
+		AAPoolManager::GetPoolMetrics(World, APoolBenchmarkActor::StaticClass(), Metrics);
+	}
+
+	const FGSRTRelayStats& Stats = Relay.GetStats();
+
+	TSharedRef<FJsonObject> Config = MakeShared<FJsonObject>();
+	Config->SetNumberField(TEXT("peers"), NumberOfPeers);
+	Config->SetNumberField(TEXT("actorsPerPeer"), ActorsPerPeer);
+	Config->SetNumberField(TEXT("tickRate"), TickRate);
+	Config->SetNumberField(TEXT("latencyMs"), LatencyMs);
+	Config->SetNumberField(TEXT("jitterMs"), JitterMs);
+	Config->SetNumberField(TEXT("loss"), PacketLoss);
+	Config->SetNumberField(TEXT("spawnRate"), SpawnRate);
+	Config->SetBoolField(TEXT("batch"), bBatch);
+	Config->SetBoolField(TEXT("relevancy"), bRelevancy);
+
+	TSharedRef<FJsonObject> RelayJson = MakeShared<FJsonObject>();
+	RelayJson->SetNumberField(TEXT("packetsInPerSecond"), Stats.PacketsIn / SimulatedSeconds);
+	RelayJson->SetNumberField(TEXT("bytesInPerSecond"), Stats.BytesIn / SimulatedSeconds);
+	RelayJson->SetNumberField(TEXT("packetsOutPerSecond"), Stats.PacketsOut / SimulatedSeconds);
+	RelayJson->SetNumberField(TEXT("bytesOutPerSecond"), Stats.BytesOut / SimulatedSeconds);
+	RelayJson->SetNumberField(TEXT("packetsLost"), Stats.PacketsLost);
+
+	TSharedRef<FJsonObject> ReplicationJson = MakeShared<FJsonObject>();
+	ReplicationJson->SetNumberField(TEXT("movementsApplied"), Results.MovementsApplied);
+	ReplicationJson->SetNumberField(TEXT("staleMovements"), Results.StaleMovements);
+	ReplicationJson->SetNumberField(TEXT("unknownNetIds"), Results.UnknownNetIds);
+	ReplicationJson->SetNumberField(TEXT("malformedPackets"), Results.MalformedPackets);
+	ReplicationJson->SetNumberField(TEXT("spawnEvents"), Results.SpawnEvents);
+	ReplicationJson->SetNumberField(TEXT("serverTimePackets"), Results.ServerTimePackets);
+	ReplicationJson->SetNumberField(TEXT("clockRoundTripMs"), Mean(Results.RoundTripTimes));
+
+	TSharedRef<FJsonObject> PoolJson = MakeShared<FJsonObject>();
+	PoolJson->SetNumberField(TEXT("numberOfObjects"), Metrics.NumberOfObjects);
+	PoolJson->SetNumberField(TEXT("highWaterMark"), Metrics.HighWaterMark);
+	PoolJson->SetNumberField(TEXT("misses"), Metrics.Misses);
+	PoolJson->SetNumberField(TEXT("spawnFallbacks"), Metrics.SpawnFallbacks);
+	PoolJson->SetNumberField(TEXT("averageAcquireUs"), Metrics.AverageAcquireMs * 1000.0);
+	PoolJson->SetNumberField(TEXT("averageReleaseUs"), Metrics.AverageReleaseMs * 1000.0);
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("engineVersion"), FEngineVersion::Current().ToString());
+	Report->SetStringField(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+	Report->SetObjectField(TEXT("config"), Config);
+	Report->SetNumberField(TEXT("simulatedSeconds"), SimulatedSeconds);
+	Report->SetNumberField(TEXT("wallSeconds"), WallSeconds);
+	Report->SetObjectField(TEXT("relay"), RelayJson);
+	Report->SetObjectField(TEXT("latency"), MakeLatencyJson(Results.Latencies));
+	Report->SetObjectField(TEXT("replication"), ReplicationJson);
+	Report->SetObjectField(TEXT("pool"), PoolJson);
+
+	FString ReportString;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	if (!FFileHelper::SaveStringToFile(ReportString, *OutputFile)) {
+		UE_LOG(LogGSRTLoadTest, Error, TEXT("Couldn't write the results to %s"), *OutputFile);
+		return 1;
+	}
+	UE_LOG(LogGSRTLoadTest, Display, TEXT("Simulated %.1f seconds in %.2f seconds, wrote the results to %s"), SimulatedSeconds, WallSeconds, *OutputFile);
+
+	return 0;
+}
@@ -0,0 +1,30 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GSRTLoadTestCommandlet.generated.h"
+
+/*
+* Simulates a realtime match against the loopback relay to measure the replication cost without GameSparks.
+* Every peer moves its pooled actors, sends their movement every tick and respawns some of them from the pool.
+*
+* UE4Editor-Cmd <Project> -run=GSRTLoadTest -nullrhi [-Peers=8] [-ActorsPerPeer=50] [-Seconds=10] [-TickRate=30]
+*     [-LatencyMs=50] [-JitterMs=0] [-Loss=0.02] [-SpawnRate=5] [-Batch] [-Relevancy] [-Seed=1] [-Output=<File>.json]
+*
+* -Batch sends the movement of a tick as one batch instead of one unreliable packet per actor and -Relevancy
+* tags the movement for the spatial relevancy filter of the relay. -JitterMs adds a random delay of up to this
+* value to the round trip, which reorders the unreliable movement. The simulated time runs as fast as possible,
+* the report contains the bandwidth, the latency, the dropped packets and the pool metrics.
+*/
+UCLASS()
+class UGSRTLoadTestCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGSRTLoadTestCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,253 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "GSRTLoopbackRelay.h"
+
+// Relevancy classes of the realtime script
+static const int64 RelevancyAlways = 0;
+static const int64 RelevancySpatial = 1;
+static const int64 RelevancyTeam = 3;
+
+static const double CellSize = 5000.0;
+static const int32 FarPacketRate = 4;
+static const double ServerTimeInterval = 1000.0;
+
+// Op code, sender and length of the packet
+static const int32 PacketHeaderBytes = 8;
+
+int32 FGSRTRelayData::GetSize() const {
+	// Every entry has a one byte index and a one byte type
+	int32 Size = 0;
+	Size += Longs.Num() * (2 + 8);
+	Size += Floats.Num() * (2 + 4);
+	for (auto& Entry : Bytes) {
+		Size += 2 + 2 + 4 * ((Entry.Value.Num() + 2) / 3);
+	}
+	for (auto& Entry : Data) {
+		Size += 2 + 2 + (Entry.Value.IsValid() ? Entry.Value->GetSize() : 0);
+	}
+
+	return Size;
+}
+
+static int32 GetPacketSize(const FGSRTRelayPacket& Packet) {
+	return PacketHeaderBytes + Packet.TargetPeers.Num() * 2 + (Packet.Data.IsValid() ? Packet.Data->GetSize() : 0);
+}
+
+FGSRTLoopbackRelay::FGSRTLoopbackRelay(double InLatencyMs, double InJitterMs, float InPacketLoss, int32 Seed) : LatencyMs(InLatencyMs), JitterMs(InJitterMs), PacketLoss(InPacketLoss), Random(Seed), LastServerTime(0.0) {
+}
+
+void FGSRTLoopbackRelay::Connect(int32 PeerId) {
+	PeerIds.AddUnique(PeerId);
+	Inboxes.FindOrAdd(PeerId);
+}
+
+void FGSRTLoopbackRelay::Disconnect(int32 PeerId) {
+	PeerIds.Remove(PeerId);
+	PeerStates.Remove(PeerId);
+	Inboxes.Remove(PeerId);
+	LastReliableArrivalsToRelay.Remove(PeerId);
+	LastReliableArrivalsToPeer.Remove(PeerId);
+}
+
+void FGSRTLoopbackRelay::Send(const FGSRTRelayPacket& Packet, double Now) {
+	Stats.PacketsIn++;
+	Stats.BytesIn += GetPacketSize(Packet);
+
+	Transmit(Packet, INDEX_NONE, Now);
+}
+
+void FGSRTLoopbackRelay::Tick(double Now) {
+	auto ByArrivalTime = [](const FInFlightPacket& A, const FInFlightPacket& B) { return A.ArrivalTime < B.ArrivalTime; };
+
+	while (InFlight.Num() > 0 && InFlight.HeapTop().ArrivalTime <= Now) {
+		FInFlightPacket Arrived;
+		InFlight.HeapPop(Arrived, ByArrivalTime, false);
+
+		if (Arrived.Receiver == INDEX_NONE) {
+			OnPacket(Arrived.Packet, Arrived.ArrivalTime);
+		}
+		else {
+			TArray<FGSRTRelayPacket>* Inbox = Inboxes.Find(Arrived.Receiver);
+			if (Inbox != nullptr) {
+				Inbox->Add(MoveTemp(Arrived.Packet));
+			}
+		}
+	}
+
+	// Send the current server time to all players every second
+	if (PeerIds.Num() >= 2 && Now - LastServerTime >= ServerTimeInterval) {
+		LastServerTime = Now;
+
+		FGSRTRelayPacket Packet;
+		Packet.OpCode = GSRTOpCode::ServerTime;
+		Packet.Data = MakeShared<FGSRTRelayData>();
+		Packet.Data->Floats.Add(1, (float)Now);
+		Packet.Data->Longs.Add(2, (int64)Now);
+		Packet.SendTime = Now;
+
+		for (int32 PeerId : PeerIds) {
+			Transmit(Packet, PeerId, Now);
+		}
+	}
+}
+
+void FGSRTLoopbackRelay::Receive(int32 PeerId, TArray<FGSRTRelayPacket>& Packets) {
+	TArray<FGSRTRelayPacket>* Inbox = Inboxes.Find(PeerId);
+	if (Inbox == nullptr) return;
+
+	Packets.Append(MoveTemp(*Inbox));
+	Inbox->Reset();
+}
+
+void FGSRTLoopbackRelay::Transmit(const FGSRTRelayPacket& Packet, int32 Receiver, double Now) {
+	if (Receiver != INDEX_NONE) {
+		Stats.PacketsOut++;
+		Stats.BytesOut += GetPacketSize(Packet);
+	}
+
+	if (!Packet.bReliable && Random.FRand() < PacketLoss) {
+		Stats.PacketsLost++;
+		return;
+	}
+
+	double ArrivalTime = Now + LatencyMs * 0.5;
+	if (JitterMs > 0.0) {
+		ArrivalTime += Random.FRand() * JitterMs * 0.5;
+	}
+
+	// A reliable channel never reorders, so the packet waits for the reliable packets sent before it
+	if (Packet.bReliable) {
+		double& LastReliableArrival = Receiver == INDEX_NONE ? LastReliableArrivalsToRelay.FindOrAdd(Packet.Sender) : LastReliableArrivalsToPeer.FindOrAdd(Receiver);
+		ArrivalTime = FMath::Max(ArrivalTime, LastReliableArrival);
+		LastReliableArrival = ArrivalTime;
+	}
+
+	FInFlightPacket InFlightPacket;
+	InFlightPacket.ArrivalTime = ArrivalTime;
+	InFlightPacket.Receiver = Receiver;
+	InFlightPacket.Packet = Packet;
+	InFlight.HeapPush(MoveTemp(InFlightPacket), [](const FInFlightPacket& A, const FInFlightPacket& B) { return A.ArrivalTime < B.ArrivalTime; });
+}
+
+void FGSRTLoopbackRelay::OnPacket(const FGSRTRelayPacket& Packet, double Now) {
+	switch (Packet.OpCode) {
+	case GSRTOpCode::Default:
+		UpdatePeerState(Packet);
+		ReplicatePacketToTargetClients(Packet, GSRTOpCode::Default, true, false, Now);
+		break;
+	case GSRTOpCode::UnreliableSequenced:
+		UpdatePeerState(Packet);
+		ReplicatePacketToTargetClients(Packet, GSRTOpCode::UnreliableSequenced, false, false, Now);
+		break;
+	case GSRTOpCode::Batch:
+		UpdatePeerState(Packet);
+		ReplicatePacketToTargetClients(Packet, GSRTOpCode::Batch, true, true, Now);
+		break;
+	case GSRTOpCode::ClockSync: {
+		// Send the packet back to the peer that sent it
+		FGSRTRelayPacket Answer;
+		Answer.OpCode = GSRTOpCode::ClockSync;
+		Answer.Sender = Packet.Sender;
+		Answer.Data = MakeShared<FGSRTRelayData>();
+		Answer.SendTime = Packet.SendTime;
+
+		if (Packet.Data.IsValid()) {
+			const float* ClientFloatTime = Packet.Data->Floats.Find(1);
+			if (ClientFloatTime != nullptr) {
+				Answer.Data->Floats.Add(1, *ClientFloatTime);
+				Answer.Data->Floats.Add(2, (float)Now);
+			}
+
+			const int64* ClientTime = Packet.Data->Longs.Find(3);
+			if (ClientTime != nullptr) {
+				Answer.Data->Longs.Add(3, *ClientTime);
+				Answer.Data->Longs.Add(4, (int64)Now);
+			}
+		}
+
+		Transmit(Answer, Packet.Sender, Now);
+		break;
+	}
+	}
+}
+
+void FGSRTLoopbackRelay::ReplicatePacketToTargetClients(const FGSRTRelayPacket& Packet, int32 OpCode, bool bReliable, bool bForwardIntact, double Now) {
+	if (PeerIds.Num() <= 1) return;
+
+	TArray<int32> TargetPeers;
+	if (Packet.TargetPeers.Num() == 0) {
+		// Broadcast
+		TargetPeers = PeerIds;
+		TargetPeers.Remove(Packet.Sender);
+
+		FilterTargetPeers(Packet, TargetPeers);
+		if (TargetPeers.Num() == 0) return;
+	}
+	else {
+		// Uni- or Multicast
+		TargetPeers = Packet.TargetPeers;
+	}
+
+	FGSRTRelayPacket PacketForClients;
+	PacketForClients.OpCode = OpCode;
+	PacketForClients.Sender = Packet.Sender;
+	PacketForClients.TargetPeers = TargetPeers;
+	PacketForClients.bReliable = bReliable;
+	PacketForClients.SendTime = Packet.SendTime;
+	if (bForwardIntact) {
+		PacketForClients.Data = Packet.Data;
+	}
+	else {
+		PacketForClients.Data = MakeShared<FGSRTRelayData>();
+		PacketForClients.Data->Data.Add(GSRTOpCode::WrapperPacketCode, Packet.Data);
+	}
+
+	for (int32 PeerId : TargetPeers) {
+		Transmit(PacketForClients, PeerId, Now);
+	}
+}
+
+void FGSRTLoopbackRelay::UpdatePeerState(const FGSRTRelayPacket& Packet) {
+	if (!Packet.Data.IsValid()) return;
+
+	FPeerState& State = PeerStates.FindOrAdd(Packet.Sender);
+
+	const float* X = Packet.Data->Floats.Find(GSRTOpCode::PositionKey);
+	const float* Y = Packet.Data->Floats.Find(GSRTOpCode::PositionKey + 1);
+	if (X != nullptr && Y != nullptr) {
+		State.bHasCell = true;
+		State.CellX = FMath::FloorToInt(*X / CellSize);
+		State.CellY = FMath::FloorToInt(*Y / CellSize);
+	}
+
+	const int64* Team = Packet.Data->Longs.Find(GSRTOpCode::TeamKey);
+	if (Team != nullptr) {
+		State.Team = *Team;
+	}
+}
+
+void FGSRTLoopbackRelay::FilterTargetPeers(const FGSRTRelayPacket& Packet, TArray<int32>& TargetPeers) {
+	const int64* Relevancy = Packet.Data.IsValid() ? Packet.Data->Longs.Find(GSRTOpCode::RelevancyKey) : nullptr;
+	if (Relevancy == nullptr || *Relevancy == RelevancyAlways) return;
+
+	FPeerState& SenderState = PeerStates.FindOrAdd(Packet.Sender);
+	bool bSendToFarPeers = false;
+	if (*Relevancy == RelevancySpatial) {
+		SenderState.FarPackets++;
+		bSendToFarPeers = SenderState.FarPackets % FarPacketRate == 0;
+	}
+
+	// Copy, adding target states may move the sender state
+	FPeerState Sender = SenderState;
+	TargetPeers.RemoveAll([&](int32 PeerId) {
+		const FPeerState& TargetState = PeerStates.FindOrAdd(PeerId);
+
+		if (*Relevancy == RelevancyTeam) {
+			return Sender.Team != TargetState.Team;
+		}
+
+		// Peers without a known position count as nearby
+		bool bIsNearby = !Sender.bHasCell || !TargetState.bHasCell || (FMath::Abs(Sender.CellX - TargetState.CellX) <= 1 && FMath::Abs(Sender.CellY - TargetState.CellY) <= 1);
+		return !bSendToFarPeers && !bIsNearby;
+	});
+}
@@ -0,0 +1,129 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Op codes and data indices of realTimeScript.js.txt
+namespace GSRTOpCode
+{
+	const int32 Default = 1;
+	const int32 ClockSync = 2;
+	const int32 ServerTime = 3;
+	const int32 UnreliableSequenced = 4;
+	const int32 Batch = 5;
+
+	const int32 WrapperPacketCode = 127;
+	const int32 RelevancyKey = 120;
+	const int32 TeamKey = 121;
+	const int32 PositionKey = 122;
+}
+
+// The parts of RTData the GSRT scripts use
+struct FGSRTRelayData {
+	TMap<int32, int64> Longs;
+	TMap<int32, float> Floats;
+	// Payloads which the clients send as Base64 strings
+	TMap<int32, TArray<uint8>> Bytes;
+	TMap<int32, TSharedPtr<FGSRTRelayData>> Data;
+
+	// Approximate size on the wire in bytes, payloads are counted with their Base64 length
+	int32 GetSize() const;
+};
+
+struct FGSRTRelayPacket {
+	int32 OpCode = GSRTOpCode::Default;
+	int32 Sender = 0;
+	// Empty for a broadcast
+	TArray<int32> TargetPeers;
+	bool bReliable = true;
+	TSharedPtr<FGSRTRelayData> Data;
+	// Time in milliseconds the original packet was sent at, only used to measure the latency
+	double SendTime = 0.0;
+};
+
+struct FGSRTRelayStats {
+	int64 PacketsIn = 0;
+	int64 BytesIn = 0;
+	int64 PacketsOut = 0;
+	int64 BytesOut = 0;
+	// Unreliable packets which were lost on the way to or from the relay
+	int64 PacketsLost = 0;
+};
+
+/*
+* In process stand-in for the GameSparks realtime relay which reproduces realTimeScript.js.txt:
+* forwarding with target peers and relevancy, clock sync echoes and the server time broadcast.
+* Both legs of a packet take half the latency plus a random delay of up to half the jitter, so unreliable packets
+* may overtake each other, and unreliable packets get lost with the given probability. Reliable packets always
+* arrive without delay for resends and in the order they were sent on their connection. Time is passed in by the
+* caller, so a harness can simulate faster than real time.
+*/
+class FGSRTLoopbackRelay
+{
+public:
+	FGSRTLoopbackRelay(double InLatencyMs, double InJitterMs, float InPacketLoss, int32 Seed);
+
+	void Connect(int32 PeerId);
+
+	void Disconnect(int32 PeerId);
+
+	// Send a packet from a peer to the relay
+	void Send(const FGSRTRelayPacket& Packet, double Now);
+
+	// Handle all packets which reached the relay until now and send the server time
+	void Tick(double Now);
+
+	// Take the packets which reached the peer until the last tick
+	void Receive(int32 PeerId, TArray<FGSRTRelayPacket>& Packets);
+
+	const FGSRTRelayStats& GetStats() const { return Stats; }
+
+private:
+	struct FInFlightPacket {
+		double ArrivalTime;
+		// INDEX_NONE for packets to the relay
+		int32 Receiver;
+		FGSRTRelayPacket Packet;
+	};
+
+	struct FPeerState {
+		bool bHasCell = false;
+		int32 CellX = 0;
+		int32 CellY = 0;
+		int64 Team = -1;
+		int32 FarPackets = 0;
+	};
+
+	double LatencyMs;
+	double JitterMs;
+	float PacketLoss;
+	FRandomStream Random;
+
+	TArray<int32> PeerIds;
+	TMap<int32, FPeerState> PeerStates;
+
+	// Heap sorted by the arrival time
+	TArray<FInFlightPacket> InFlight;
+
+	// Arrival time of the last reliable packet on the connection of a peer, to the relay and from the relay
+	TMap<int32, double> LastReliableArrivalsToRelay;
+	TMap<int32, double> LastReliableArrivalsToPeer;
+
+	// Packets which reached the peers
+	TMap<int32, TArray<FGSRTRelayPacket>> Inboxes;
+
+	double LastServerTime;
+
+	FGSRTRelayStats Stats;
+
+	void Transmit(const FGSRTRelayPacket& Packet, int32 Receiver, double Now);
+
+	void OnPacket(const FGSRTRelayPacket& Packet, double Now);
+
+	void ReplicatePacketToTargetClients(const FGSRTRelayPacket& Packet, int32 OpCode, bool bReliable, bool bForwardIntact, double Now);
+
+	void UpdatePeerState(const FGSRTRelayPacket& Packet);
+
+	void FilterTargetPeers(const FGSRTRelayPacket& Packet, TArray<int32>& TargetPeers);
+};
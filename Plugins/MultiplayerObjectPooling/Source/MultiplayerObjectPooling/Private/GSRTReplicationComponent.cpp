@@ -0,0 +1,333 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "GSRTReplicationComponent.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "GameFramework/Actor.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+#include "GSRTUtilities.h"
+
+static void SerializeQuantizedFloat(FArchive& Ar, float& Value, float Precision) {
+	if (Precision <= 0.f) {
+		Ar << Value;
+		return;
+	}
+
+	int32 Quantized = (int32)FMath::Clamp<double>(FMath::RoundToDouble(Value / Precision), MIN_int32, MAX_int32);
+	UGSRTUtilities::SerializeZigZag(Ar, Quantized);
+	if (Ar.IsLoading()) {
+		Value = Quantized * Precision;
+	}
+}
+
+// Reads or writes a single variable, the same function is used in both directions so they can't get out of sync
+static void SerializeReplicatedProperty(FArchive& Ar, const FGSRTReplicatedProperty& Replicated, void* Value) {
+	switch (Replicated.Type) {
+	case EGSRTPropertyType::Bool: {
+		UBoolProperty* BoolProperty = (UBoolProperty*)Replicated.Property;
+		uint8 Bit = BoolProperty->GetPropertyValue(Value) ? 1 : 0;
+		Ar.SerializeBits(&Bit, 1);
+		if (Ar.IsLoading()) {
+			BoolProperty->SetPropertyValue(Value, Bit != 0);
+		}
+		break;
+	}
+	case EGSRTPropertyType::Byte:
+		Ar << *(uint8*)Value;
+		break;
+	case EGSRTPropertyType::Int:
+		UGSRTUtilities::SerializeZigZag(Ar, *(int32*)Value);
+		break;
+	case EGSRTPropertyType::Float:
+		SerializeQuantizedFloat(Ar, *(float*)Value, Replicated.Precision);
+		break;
+	case EGSRTPropertyType::Vector: {
+		FVector& Vector = *(FVector*)Value;
+		SerializeQuantizedFloat(Ar, Vector.X, Replicated.Precision);
+		SerializeQuantizedFloat(Ar, Vector.Y, Replicated.Precision);
+		SerializeQuantizedFloat(Ar, Vector.Z, Replicated.Precision);
+		break;
+	}
+	case EGSRTPropertyType::Rotator:
+		((FRotator*)Value)->SerializeCompressedShort(Ar);
+		break;
+	case EGSRTPropertyType::String:
+		Ar << *(FString*)Value;
+		break;
+	case EGSRTPropertyType::Name: {
+		// Bit archives don't serialize names, send the plain string instead
+		FString Name = ((FName*)Value)->ToString();
+		Ar << Name;
+		if (Ar.IsLoading()) {
+			*(FName*)Value = FName(*Name);
+		}
+		break;
+	}
+	}
+}
+
+UGSRTReplicationComponent::UGSRTReplicationComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	VectorPrecision = 0.01f;
+	bHasProperties = false;
+	NextSequence = 0;
+	bHasReceivedState = false;
+	LastReceivedSequence = 0;
+}
+
+void UGSRTReplicationComponent::WriteState(const TArray<int32>& TargetPeers, TArray<uint8>& Payload) {
+	BuildProperties();
+
+	FGSRTStateSnapshot Snapshot;
+	Snapshot.Sequence = NextSequence++;
+	CaptureSnapshot(Snapshot);
+
+	// The newest state every target peer has, it exists on their side too. A broadcast reaches every known peer
+	const TArray<int32>& BaselinePeers = TargetPeers.Num() > 0 ? TargetPeers : KnownPeers;
+	FGSRTStateSnapshot* Baseline = nullptr;
+	if (BaselinePeers.Num() > 0) {
+		for (int32 i = SentStates.Num() - 1; i >= 0 && Baseline == nullptr; i--) {
+			bool bAckedByAll = true;
+			for (int32 PeerId : BaselinePeers) {
+				if (!SentStates[i].AckedPeers.Contains(PeerId)) {
+					bAckedByAll = false;
+					break;
+				}
+			}
+
+			if (bAckedByAll) {
+				Baseline = &SentStates[i];
+			}
+		}
+	}
+
+	FBitWriter Writer(0, true);
+	uint16 Sequence = Snapshot.Sequence;
+	Writer << Sequence;
+
+	uint8 bIsDelta = Baseline != nullptr ? 1 : 0;
+	Writer.SerializeBits(&bIsDelta, 1);
+	if (bIsDelta) {
+		uint16 BaselineSequence = Baseline->Sequence;
+		Writer << BaselineSequence;
+	}
+
+	for (int32 i = 0; i < Properties.Num(); i++) {
+		uint8* Data = Snapshot.Data.GetData() + Snapshot.ByteOffsets[i];
+
+		if (bIsDelta) {
+			uint8 bChanged = Snapshot.NumBits[i] != Baseline->NumBits[i] || FMemory::Memcmp(Data, Baseline->Data.GetData() + Baseline->ByteOffsets[i], (Snapshot.NumBits[i] + 7) >> 3) != 0;
+			Writer.SerializeBits(&bChanged, 1);
+			if (!bChanged) continue;
+		}
+
+		Writer.SerializeBits(Data, Snapshot.NumBits[i]);
+	}
+
+	Payload.SetNumUninitialized(Writer.GetNumBytes());
+	FMemory::Memcpy(Payload.GetData(), Writer.GetData(), Writer.GetNumBytes());
+
+	AddSnapshot(SentStates, MoveTemp(Snapshot));
+}
+
+bool UGSRTReplicationComponent::ReadState(const TArray<uint8>& Payload, int32& Sequence) {
+	AActor* Owner = GetOwner();
+	if (Owner == nullptr) return false;
+
+	BuildProperties();
+
+	FBitReader Reader((uint8*)Payload.GetData(), Payload.Num() * 8);
+	uint16 PacketSequence = 0;
+	Reader << PacketSequence;
+	Sequence = PacketSequence;
+
+	if (bHasReceivedState && !GSRTSequence::IsNewer(PacketSequence, LastReceivedSequence)) return false;
+
+	uint8 bIsDelta = 0;
+	Reader.SerializeBits(&bIsDelta, 1);
+
+	FGSRTStateSnapshot* Baseline = nullptr;
+	if (bIsDelta) {
+		uint16 BaselineSequence = 0;
+		Reader << BaselineSequence;
+		Baseline = FindSnapshot(ReceivedStates, BaselineSequence);
+		if (Baseline == nullptr) return false;
+	}
+
+	// Decoded into temporary values first, a malformed payload must not leave the owner half applied
+	TArray<void*, TInlineAllocator<16>> Values;
+	Values.Reserve(Properties.Num());
+	for (const FGSRTReplicatedProperty& Replicated : Properties) {
+		void* Value = FMemory::Malloc(Replicated.Property->ElementSize, Replicated.Property->GetMinAlignment());
+		Replicated.Property->InitializeValue(Value);
+		Values.Add(Value);
+	}
+
+	for (int32 i = 0; i < Properties.Num() && !Reader.IsError(); i++) {
+		const FGSRTReplicatedProperty& Replicated = Properties[i];
+		void* Value = Values[i];
+
+		uint8 bChanged = 1;
+		if (bIsDelta) {
+			Reader.SerializeBits(&bChanged, 1);
+		}
+
+		if (bChanged) {
+			SerializeReplicatedProperty(Reader, Replicated, Value);
+		}
+		else {
+			// The receiver may have applied newer states than the baseline, so unchanged variables come from the baseline
+			FBitReader BaselineReader(Baseline->Data.GetData() + Baseline->ByteOffsets[i], Baseline->NumBits[i]);
+			SerializeReplicatedProperty(BaselineReader, Replicated, Value);
+		}
+	}
+
+	bool bIsValid = !Reader.IsError();
+	for (int32 i = 0; i < Properties.Num(); i++) {
+		UProperty* Property = Properties[i].Property;
+		if (bIsValid) {
+			Property->CopySingleValue(Property->ContainerPtrToValuePtr<void>(Owner), Values[i]);
+		}
+		Property->DestroyValue(Values[i]);
+		FMemory::Free(Values[i]);
+	}
+
+	if (!bIsValid) return false;
+
+	FGSRTStateSnapshot Snapshot;
+	Snapshot.Sequence = PacketSequence;
+	CaptureSnapshot(Snapshot);
+	AddSnapshot(ReceivedStates, MoveTemp(Snapshot));
+
+	bHasReceivedState = true;
+	LastReceivedSequence = PacketSequence;
+
+	return true;
+}
+
+void UGSRTReplicationComponent::Acknowledge(int32 PeerId, int32 Sequence) {
+	FGSRTStateSnapshot* Snapshot = FindSnapshot(SentStates, (uint16)Sequence);
+	if (Snapshot != nullptr) {
+		Snapshot->AckedPeers.AddUnique(PeerId);
+		KnownPeers.AddUnique(PeerId);
+	}
+}
+
+void UGSRTReplicationComponent::AddPeer(int32 PeerId) {
+	KnownPeers.AddUnique(PeerId);
+}
+
+void UGSRTReplicationComponent::RemovePeer(int32 PeerId) {
+	KnownPeers.Remove(PeerId);
+}
+
+void UGSRTReplicationComponent::ResetReplication() {
+	SentStates.Empty();
+	ReceivedStates.Empty();
+	bHasReceivedState = false;
+}
+
+void UGSRTReplicationComponent::PoolableBeginPlay_Implementation() {
+}
+
+void UGSRTReplicationComponent::PoolableEndPlay_Implementation(const EEndPlayReason::Type EndPlayReason) {
+	// The next user of the pooled actor starts with full states
+	ResetReplication();
+}
+
+void UGSRTReplicationComponent::BuildProperties() {
+	if (bHasProperties) return;
+	bHasProperties = true;
+
+	AActor* Owner = GetOwner();
+	if (Owner == nullptr) return;
+
+	// Only variables which were added in Blueprints, the native replicated variables of the engine are handled by the engine
+	for (TFieldIterator<UProperty> It(Owner->GetClass()); It; ++It) {
+		UProperty* Property = *It;
+		if (!Property->HasAnyPropertyFlags(CPF_Net) || Property->ArrayDim != 1) continue;
+		if (Cast<UBlueprintGeneratedClass>(Property->GetOwnerClass()) == nullptr) continue;
+
+		FGSRTReplicatedProperty Replicated;
+		Replicated.Property = Property;
+		Replicated.Precision = 0.f;
+
+		UStructProperty* StructProperty = Cast<UStructProperty>(Property);
+		if (Property->IsA<UBoolProperty>()) {
+			Replicated.Type = EGSRTPropertyType::Bool;
+		}
+		else if (Property->IsA<UByteProperty>() || (Property->IsA<UEnumProperty>() && Property->ElementSize == 1)) {
+			Replicated.Type = EGSRTPropertyType::Byte;
+		}
+		else if (Property->IsA<UIntProperty>()) {
+			Replicated.Type = EGSRTPropertyType::Int;
+		}
+		else if (Property->IsA<UFloatProperty>()) {
+			Replicated.Type = EGSRTPropertyType::Float;
+		}
+		else if (StructProperty != nullptr && StructProperty->Struct == TBaseStructure<FVector>::Get()) {
+			Replicated.Type = EGSRTPropertyType::Vector;
+			Replicated.Precision = VectorPrecision;
+		}
+		else if (StructProperty != nullptr && StructProperty->Struct == TBaseStructure<FRotator>::Get()) {
+			Replicated.Type = EGSRTPropertyType::Rotator;
+		}
+		else if (Property->IsA<UStrProperty>()) {
+			Replicated.Type = EGSRTPropertyType::String;
+		}
+		else if (Property->IsA<UNameProperty>()) {
+			Replicated.Type = EGSRTPropertyType::Name;
+		}
+		else {
+			UE_LOG(LogTemp, Warning, TEXT("The replicated variable %s of %s has an unsupported type and won't be replicated!"), *Property->GetName(), *Owner->GetClass()->GetName());
+			continue;
+		}
+
+		const float* Precision = PropertyPrecisions.Find(Property->GetFName());
+		if (Precision != nullptr) {
+			Replicated.Precision = *Precision;
+		}
+
+		Properties.Add(Replicated);
+	}
+}
+
+void UGSRTReplicationComponent::CaptureSnapshot(FGSRTStateSnapshot& Snapshot) {
+	AActor* Owner = GetOwner();
+
+	FBitWriter Writer(0, true);
+	Snapshot.ByteOffsets.SetNumUninitialized(Properties.Num());
+	Snapshot.NumBits.SetNumUninitialized(Properties.Num());
+
+	for (int32 i = 0; i < Properties.Num(); i++) {
+		int64 StartBits = Writer.GetNumBits();
+		Snapshot.ByteOffsets[i] = (int32)(StartBits >> 3);
+
+		SerializeReplicatedProperty(Writer, Properties[i], Properties[i].Property->ContainerPtrToValuePtr<void>(Owner));
+
+		Snapshot.NumBits[i] = (int32)(Writer.GetNumBits() - StartBits);
+		Writer.WriteAlign();
+	}
+
+	Snapshot.Data.SetNumUninitialized(Writer.GetNumBytes());
+	FMemory::Memcpy(Snapshot.Data.GetData(), Writer.GetData(), Writer.GetNumBytes());
+}
+
+void UGSRTReplicationComponent::AddSnapshot(TArray<FGSRTStateSnapshot>& History, FGSRTStateSnapshot&& Snapshot) {
+	if (History.Num() >= HistorySize) {
+		History.RemoveAt(0, 1, false);
+	}
+	History.Add(MoveTemp(Snapshot));
+}
+
+FGSRTStateSnapshot* UGSRTReplicationComponent::FindSnapshot(TArray<FGSRTStateSnapshot>& History, uint16 Sequence) {
+	for (auto& Snapshot : History) {
+		if (Snapshot.Sequence == Sequence) {
+			return &Snapshot;
+		}
+	}
+
+	return nullptr;
+}
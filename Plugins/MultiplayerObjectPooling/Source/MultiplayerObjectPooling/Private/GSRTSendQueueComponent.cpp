@@ -0,0 +1,99 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "GSRTSendQueueComponent.h"
+
+static void WriteLength(TArray<uint8>& Data, uint32 Length) {
+	while (Length >= 0x80) {
+		Data.Add((uint8)(Length | 0x80));
+		Length >>= 7;
+	}
+	Data.Add((uint8)Length);
+}
+
+static bool ReadLength(const TArray<uint8>& Data, int32& Offset, uint32& Length) {
+	Length = 0;
+	for (int32 Shift = 0; Shift < 32; Shift += 7) {
+		if (Offset >= Data.Num()) return false;
+
+		uint8 Byte = Data[Offset++];
+		Length |= (uint32)(Byte & 0x7F) << Shift;
+		if ((Byte & 0x80) == 0) return true;
+	}
+
+	return false;
+}
+
+UGSRTSendQueueComponent::UGSRTSendQueueComponent()
+{
+	// Only ticks while messages are queued, after everything else of the frame
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+
+	MaxBatchBytes = 1024;
+}
+
+void UGSRTSendQueueComponent::Enqueue(const TArray<uint8>& Message, const TArray<int32>& TargetPeers) {
+	int32 BatchIndex = Batches.IndexOfByPredicate([&TargetPeers](const FGSRTBatch& Batch) { return Batch.TargetPeers == TargetPeers; });
+	if (BatchIndex == INDEX_NONE) {
+		BatchIndex = Batches.AddDefaulted();
+		Batches[BatchIndex].TargetPeers = TargetPeers;
+	}
+
+	// Length prefix of at most 5 bytes
+	if (Batches[BatchIndex].Data.Num() > 0 && Batches[BatchIndex].Data.Num() + Message.Num() + 5 > MaxBatchBytes) {
+		SendBatch(Batches[BatchIndex]);
+	}
+
+	AppendMessage(Batches[BatchIndex].Data, Message);
+
+	SetComponentTickEnabled(true);
+}
+
+void UGSRTSendQueueComponent::Flush() {
+	// A listener may queue new messages while the batches are sent, so the array can grow
+	for (int32 i = 0; i < Batches.Num(); i++) {
+		if (Batches[i].Data.Num() > 0) {
+			SendBatch(Batches[i]);
+		}
+	}
+
+	Batches.RemoveAll([](const FGSRTBatch& Batch) { return Batch.Data.Num() == 0; });
+	SetComponentTickEnabled(Batches.Num() > 0);
+}
+
+bool UGSRTSendQueueComponent::SplitBatch(const TArray<uint8>& Batch, TArray<FGSRTMessage>& Messages) {
+	Messages.Reset();
+
+	int32 Offset = 0;
+	while (Offset < Batch.Num()) {
+		uint32 Length;
+		if (!ReadLength(Batch, Offset, Length) || Length > (uint32)(Batch.Num() - Offset)) return false;
+
+		FGSRTMessage& Message = Messages[Messages.AddDefaulted()];
+		Message.Data.Append(Batch.GetData() + Offset, Length);
+		Offset += Length;
+	}
+
+	return true;
+}
+
+void UGSRTSendQueueComponent::AppendMessage(TArray<uint8>& Batch, const TArray<uint8>& Message) {
+	WriteLength(Batch, Message.Num());
+	Batch.Append(Message);
+}
+
+void UGSRTSendQueueComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) {
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	Flush();
+}
+
+void UGSRTSendQueueComponent::SendBatch(FGSRTBatch& Batch) {
+	// Copy the target peers, a listener might queue new messages and move the batches
+	TArray<int32> TargetPeers = Batch.TargetPeers;
+	TArray<uint8> Data = MoveTemp(Batch.Data);
+	Batch.Data.Reset(MaxBatchBytes);
+
+	OnBatchReady.Broadcast(Data, TargetPeers);
+}
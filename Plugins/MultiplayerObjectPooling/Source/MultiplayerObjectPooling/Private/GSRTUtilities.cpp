@@ -1,9 +1,65 @@
 // Copyright 2019 (C) Ramn Janousch
 
 #include "GSRTUtilities.h"
+#include "Misc/Base64.h"
+#include "GSRTReplicationComponent.h"
+
+// Op codes of the realtime script
+static const int32 DefaultOpCode = 1;
+static const int32 UnreliableSequencedOpCode = 4;
+static const int32 BatchOpCode = 5;
+
+// Relevancy indices of the realtime script
+static const int32 RelevancyDataIndex = 120;
+static const int32 TeamDataIndex = 121;
+static const int32 PositionDataIndex = 122;
 
 
 UObject* UGSRTUtilities::CreateObject(TSubclassOf<UObject> Class) {
 	return NewObject<UObject>((UObject*)GetTransientPackage(), Class);
 }
 
+FString UGSRTUtilities::BytesToBase64(const TArray<uint8>& Bytes) {
+	return FBase64::Encode(Bytes);
+}
+
+bool UGSRTUtilities::Base64ToBytes(const FString& Base64, TArray<uint8>& Bytes) {
+	return FBase64::Decode(Base64, Bytes);
+}
+
+int32 UGSRTUtilities::GetDeliveryOpCode(EGSRTDelivery Delivery) {
+	switch (Delivery) {
+	case EGSRTDelivery::UnreliableSequenced:
+		return UnreliableSequencedOpCode;
+	case EGSRTDelivery::Batch:
+		return BatchOpCode;
+	default:
+		return DefaultOpCode;
+	}
+}
+
+void UGSRTUtilities::GetRelevancyDataIndices(int32& RelevancyIndex, int32& TeamIndex, int32& PositionIndex) {
+	RelevancyIndex = RelevancyDataIndex;
+	TeamIndex = TeamDataIndex;
+	PositionIndex = PositionDataIndex;
+}
+
+int32 UGSRTUtilities::NextSequence(FGSRTSequenceChannel& Channel) {
+	return Channel.NextSequence++;
+}
+
+bool UGSRTUtilities::AcceptSequence(FGSRTSequenceChannel& Channel, int32 SenderPeerId, int32 Sequence) {
+	uint16* LastReceivedSequence = Channel.LastReceivedSequences.Find(SenderPeerId);
+	if (LastReceivedSequence != nullptr && !GSRTSequence::IsNewer((uint16)Sequence, *LastReceivedSequence)) return false;
+
+	Channel.LastReceivedSequences.Add(SenderPeerId, (uint16)Sequence);
+	return true;
+}
+
+void UGSRTUtilities::SerializeZigZag(FArchive& Ar, int32& Value) {
+	uint32 Encoded = ((uint32)Value << 1) ^ (uint32)(Value >> 31);
+	Ar.SerializeIntPacked(Encoded);
+	if (Ar.IsLoading()) {
+		Value = (int32)(Encoded >> 1) ^ -(int32)(Encoded & 1);
+	}
+}
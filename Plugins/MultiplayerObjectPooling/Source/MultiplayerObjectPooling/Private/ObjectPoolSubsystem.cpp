@@ -0,0 +1,19 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "ObjectPoolSubsystem.h"
+#include "APoolManager.h"
+
+void UObjectPoolSubsystem::RegisterPoolManager(AAPoolManager* InPoolManager) {
+	if (IsValid(PoolManager) && PoolManager != InPoolManager) {
+		UE_LOG(LogTemp, Error, TEXT("There is already a pool manager in %s, %s is ignored!"), *GetWorld()->GetName(), *InPoolManager->GetName());
+		return;
+	}
+
+	PoolManager = InPoolManager;
+}
+
+void UObjectPoolSubsystem::UnregisterPoolManager(AAPoolManager* InPoolManager) {
+	if (PoolManager == InPoolManager) {
+		PoolManager = nullptr;
+	}
+}
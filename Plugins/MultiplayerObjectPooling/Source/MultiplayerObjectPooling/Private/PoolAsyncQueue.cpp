@@ -0,0 +1,90 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "PoolAsyncQueue.h"
+#include "PoolHolder.h"
+
+FPoolAsyncQueue::FPoolAsyncQueue(int32 InPoolIndex, int32 Capacity) : PoolIndex(InPoolIndex), Head(0), Tail(0), bClosed(false) {
+	// A power of two, so the free running indices can be masked
+	uint32 Size = FMath::RoundUpToPowerOfTwo(FMath::Max(Capacity, 1));
+	Reservations = MakeUnique<TAtomic<int32>[]>(Size);
+	Mask = Size - 1;
+}
+
+int32 FPoolAsyncQueue::Reserve() {
+	while (!bClosed) {
+		uint32 CurrentHead = Head;
+		if (CurrentHead == Tail) return INDEX_NONE;
+
+		// The game thread only overwrites this entry after the head moved on, then the exchange fails
+		int32 Handle = Reservations[CurrentHead & Mask];
+		if (Head.CompareExchange(CurrentHead, CurrentHead + 1)) return Handle;
+	}
+
+	return INDEX_NONE;
+}
+
+void FPoolAsyncQueue::Spawn(int32 Handle) {
+	FPoolAsyncRequest Request;
+	Request.bRelease = false;
+	Request.bHasTransform = false;
+	Request.EndPlayReason = EEndPlayReason::Destroyed;
+	Enqueue(Handle, Request);
+}
+
+void FPoolAsyncQueue::Spawn(int32 Handle, const FTransform& Transform) {
+	FPoolAsyncRequest Request;
+	Request.bRelease = false;
+	Request.bHasTransform = true;
+	Request.EndPlayReason = EEndPlayReason::Destroyed;
+	Request.Transform = Transform;
+	Enqueue(Handle, Request);
+}
+
+void FPoolAsyncQueue::Release(int32 Handle, const EEndPlayReason::Type EndPlayReason) {
+	FPoolAsyncRequest Request;
+	Request.bRelease = true;
+	Request.bHasTransform = false;
+	Request.EndPlayReason = EndPlayReason;
+	Enqueue(Handle, Request);
+}
+
+int32 FPoolAsyncQueue::GetNetId(int32 Handle) const {
+	if (PoolIndex == INDEX_NONE || Handle < 0) return INDEX_NONE;
+
+	return PoolNetId::Make(PoolIndex, PoolAsyncHandle::GetSlotHandle(Handle));
+}
+
+bool FPoolAsyncQueue::IsClosed() const {
+	return bClosed;
+}
+
+void FPoolAsyncQueue::Enqueue(int32 Handle, FPoolAsyncRequest& Request) {
+	if (bClosed || Handle < 0) return;
+
+	Request.SlotHandle = PoolAsyncHandle::GetSlotHandle(Handle);
+	Request.Generation = PoolAsyncHandle::GetGeneration(Handle);
+	Requests.Enqueue(Request);
+}
+
+bool FPoolAsyncQueue::AddReservation(int32 Handle) {
+	uint32 CurrentTail = Tail;
+	if (CurrentTail - Head > Mask) return false;
+
+	Reservations[CurrentTail & Mask] = Handle;
+	Tail = CurrentTail + 1;
+	return true;
+}
+
+int32 FPoolAsyncQueue::GetNumberOfReservations() const {
+	// Read the head last, it can only move towards the tail in the meantime
+	uint32 CurrentTail = Tail;
+	return (int32)(CurrentTail - Head);
+}
+
+bool FPoolAsyncQueue::Dequeue(FPoolAsyncRequest& Request) {
+	return Requests.Dequeue(Request);
+}
+
+void FPoolAsyncQueue::Close() {
+	bClosed = true;
+}
@@ -0,0 +1,73 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "PoolBenchmark.h"
+#include "Engine.h"
+
+APoolBenchmarkActor::APoolBenchmarkActor()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+void APoolBenchmarkActor::AddBenchmarkComponents(int32 Count) {
+	for (int32 i = 0; i < Count; i++) {
+		FName ComponentName = *FString::Printf(TEXT("Component%d"), i);
+		USceneComponent* Component;
+		if (i % 5 == 0) {
+			Component = CreateDefaultSubobject<UStaticMeshComponent>(ComponentName);
+		}
+		else {
+			Component = CreateDefaultSubobject<USceneComponent>(ComponentName);
+		}
+		Component->SetupAttachment(RootComponent);
+	}
+}
+
+APoolBenchmarkActor5Components::APoolBenchmarkActor5Components()
+{
+	AddBenchmarkComponents(5);
+}
+
+APoolBenchmarkActor20Components::APoolBenchmarkActor20Components()
+{
+	AddBenchmarkComponents(20);
+}
+
+double APoolBenchmarkManager::InitializeBenchmarkPools(const TArray<FPoolSpecification>& PoolSpecifications) {
+	SetDesiredPools(PoolSpecifications);
+
+	double StartTime = FPlatformTime::Seconds();
+	InitializePools();
+
+	return (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+FPoolBenchmarkWorld::FPoolBenchmarkWorld()
+{
+	// The game instance creates the world and its world context, which keeps both alive during garbage collections
+	GameInstance = NewObject<UGameInstance>(GEngine);
+	GameInstance->InitializeStandalone();
+	World = GameInstance->GetWorld();
+
+	// Without a game mode the world never begins play and spawned actors don't get their BeginPlay
+	FURL URL;
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+	World->BeginPlay();
+
+	// BeginPlay of the manager registers it as the pool manager of this world
+	PoolManager = World->SpawnActor<APoolBenchmarkManager>();
+	if (AAPoolManager::GetPoolManager(World) != PoolManager) {
+		UE_LOG(LogTemp, Error, TEXT("The benchmark pool manager didn't begin play, every request will miss!"));
+	}
+}
+
+FPoolBenchmarkWorld::~FPoolBenchmarkWorld()
+{
+	GameInstance->Shutdown();
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
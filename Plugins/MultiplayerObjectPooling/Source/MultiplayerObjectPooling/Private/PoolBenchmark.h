@@ -0,0 +1,78 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "APoolManager.h"
+#include "PoolBenchmark.generated.h"
+
+// Pooled actor without any components besides its root
+UCLASS(NotBlueprintable, NotPlaceable, Transient)
+class APoolBenchmarkActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	APoolBenchmarkActor();
+
+protected:
+	// Attach Count components to the root, every fifth one is a static mesh component
+	void AddBenchmarkComponents(int32 Count);
+};
+
+UCLASS(NotBlueprintable, NotPlaceable, Transient)
+class APoolBenchmarkActor5Components : public APoolBenchmarkActor
+{
+	GENERATED_BODY()
+
+public:
+	APoolBenchmarkActor5Components();
+};
+
+UCLASS(NotBlueprintable, NotPlaceable, Transient)
+class APoolBenchmarkActor20Components : public APoolBenchmarkActor
+{
+	GENERATED_BODY()
+
+public:
+	APoolBenchmarkActor20Components();
+};
+
+// Pooled object which is not an actor
+UCLASS(NotBlueprintable, Transient)
+class UPoolBenchmarkObject : public UObject
+{
+	GENERATED_BODY()
+};
+
+// Pool manager which can be spawned by code, the regular one is abstract and configured in a level
+UCLASS(NotBlueprintable, NotPlaceable, Transient)
+class APoolBenchmarkManager : public AAPoolManager
+{
+	GENERATED_BODY()
+
+public:
+	// Replace all pools with the given ones, returns the time it took in milliseconds
+	double InitializeBenchmarkPools(const TArray<FPoolSpecification>& PoolSpecifications);
+};
+
+/*
+* Game world without a level to run the pools outside of the editor, e.g. in a commandlet with -nullrhi or an automation test.
+* The world is owned by its own game instance and has a game mode, so it really begins play. It contains a pool manager
+* which ran its BeginPlay and is registered as the pool manager of the world.
+*/
+class FPoolBenchmarkWorld
+{
+public:
+	FPoolBenchmarkWorld();
+	~FPoolBenchmarkWorld();
+
+	UWorld* GetWorld() const { return World; }
+	APoolBenchmarkManager* GetPoolManager() const { return PoolManager; }
+
+private:
+	UGameInstance* GameInstance;
+	UWorld* World;
+	APoolBenchmarkManager* PoolManager;
+};
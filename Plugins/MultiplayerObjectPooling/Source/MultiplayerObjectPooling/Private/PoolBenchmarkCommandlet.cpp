@@ -0,0 +1,319 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "PoolBenchmarkCommandlet.h"
+#include "Engine.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Dom/JsonObject.h"
+#include "PoolBenchmark.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPoolBenchmark, Log, All);
+
+// Latency distribution of single operations in microseconds
+static TSharedRef<FJsonObject> MakeLatencyJson(TArray<uint64>& Samples) {
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	if (Samples.Num() == 0) return Json;
+
+	Samples.Sort();
+
+	uint64 TotalCycles = 0;
+	for (uint64 Sample : Samples) {
+		TotalCycles += Sample;
+	}
+
+	auto ToMicroseconds = [](uint64 Cycles) { return FPlatformTime::ToMilliseconds64(Cycles) * 1000.0; };
+	auto Percentile = [&Samples](double Fraction) { return Samples[FMath::Min(Samples.Num() - 1, (int32)(Samples.Num() * Fraction))]; };
+
+	double TotalMicroseconds = ToMicroseconds(TotalCycles);
+	Json->SetNumberField(TEXT("opsPerSecond"), TotalMicroseconds > 0.0 ? Samples.Num() / (TotalMicroseconds / 1000000.0) : 0.0);
+	Json->SetNumberField(TEXT("meanUs"), TotalMicroseconds / Samples.Num());
+	Json->SetNumberField(TEXT("p50Us"), ToMicroseconds(Percentile(0.5)));
+	Json->SetNumberField(TEXT("p99Us"), ToMicroseconds(Percentile(0.99)));
+	Json->SetNumberField(TEXT("maxUs"), ToMicroseconds(Samples.Last()));
+
+	return Json;
+}
+
+// Throughput of batch operations, the latency is the mean per object
+static TSharedRef<FJsonObject> MakeBatchJson(double TotalSeconds, int32 NumberOfObjects) {
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	if (NumberOfObjects == 0) return Json;
+
+	Json->SetNumberField(TEXT("opsPerSecond"), TotalSeconds > 0.0 ? NumberOfObjects / TotalSeconds : 0.0);
+	Json->SetNumberField(TEXT("meanUs"), TotalSeconds * 1000000.0 / NumberOfObjects);
+
+	return Json;
+}
+
+UPoolBenchmarkCommandlet::UPoolBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UPoolBenchmarkCommandlet::Main(const FString& Params) {
+	FString SizesString = TEXT("100,1000,10000,50000");
+	FParse::Value(*Params, TEXT("Sizes="), SizesString);
+
+	int32 Iterations = 3;
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+
+	FString OutputFile = FPaths::ProjectSavedDir() / TEXT("PoolBenchmark") / TEXT("PoolBenchmark.json");
+	FParse::Value(*Params, TEXT("Output="), OutputFile);
+
+	FString BaselineFile;
+	FParse::Value(*Params, TEXT("Baseline="), BaselineFile);
+
+	float Tolerance = 0.1f;
+	FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+
+	TArray<FString> SizeStrings;
+	SizesString.ParseIntoArray(SizeStrings, TEXT(","));
+
+	TArray<int32> PoolSizes;
+	for (auto& SizeString : SizeStrings) {
+		int32 PoolSize = FCString::Atoi(*SizeString);
+		if (PoolSize > 0) {
+			PoolSizes.Add(PoolSize);
+		}
+	}
+
+	TArray<UClass*> Classes = {
+		APoolBenchmarkActor::StaticClass(),
+		APoolBenchmarkActor5Components::StaticClass(),
+		APoolBenchmarkActor20Components::StaticClass(),
+		UPoolBenchmarkObject::StaticClass()
+	};
+
+	TArray<TSharedPtr<FJsonObject>> Results;
+	{
+		FPoolBenchmarkWorld BenchmarkWorld;
+
+		for (UClass* Class : Classes) {
+			for (int32 PoolSize : PoolSizes) {
+				UE_LOG(LogPoolBenchmark, Display, TEXT("Benchmarking %s with %d objects"), *Class->GetName(), PoolSize);
+				Results.Add(RunBenchmark(BenchmarkWorld.GetPoolManager(), Class, PoolSize, Iterations));
+			}
+
+			// Destroy the pools of this class before the next one gets created
+			BenchmarkWorld.GetPoolManager()->InitializeBenchmarkPools(TArray<FPoolSpecification>());
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		}
+
+		for (int32 PoolSize : PoolSizes) {
+			UE_LOG(LogPoolBenchmark, Display, TEXT("Benchmarking the garbage collection with %d objects"), PoolSize);
+			Results.Add(RunGarbageCollectionBenchmark(BenchmarkWorld.GetPoolManager(), PoolSize, Iterations));
+		}
+	}
+
+	// Every pool is large enough for its benchmark, a miss means the pools didn't work at all
+	bool bHasMisses = false;
+	double Misses;
+	for (auto& Result : Results) {
+		if (Result->TryGetNumberField(TEXT("misses"), Misses) && Misses > 0) {
+			UE_LOG(LogPoolBenchmark, Error, TEXT("%s with %d objects had %d misses, the results are invalid"), *Result->GetStringField(TEXT("type")), (int32)Result->GetNumberField(TEXT("poolSize")), (int32)Misses);
+			bHasMisses = true;
+		}
+	}
+
+	TArray<TSharedPtr<FJsonValue>> ResultValues;
+	for (auto& Result : Results) {
+		ResultValues.Add(MakeShared<FJsonValueObject>(Result));
+	}
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("engineVersion"), FEngineVersion::Current().ToString());
+	Report->SetStringField(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+	Report->SetNumberField(TEXT("iterations"), Iterations);
+	Report->SetArrayField(TEXT("results"), ResultValues);
+
+	FString ReportString;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	if (!FFileHelper::SaveStringToFile(ReportString, *OutputFile)) {
+		UE_LOG(LogPoolBenchmark, Error, TEXT("Couldn't write the results to %s"), *OutputFile);
+		return 1;
+	}
+	UE_LOG(LogPoolBenchmark, Display, TEXT("Wrote the results to %s"), *OutputFile);
+
+	if (bHasMisses) {
+		return 1;
+	}
+
+	if (!BaselineFile.IsEmpty() && !CompareWithBaseline(Results, BaselineFile, Tolerance)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+TSharedRef<FJsonObject> UPoolBenchmarkCommandlet::RunBenchmark(APoolBenchmarkManager* PoolManager, UClass* Class, int32 PoolSize, int32 Iterations) {
+	FPoolSpecification PoolSpecification;
+	PoolSpecification.Class = Class;
+	PoolSpecification.NumberOfObjects = PoolSize;
+
+	double WarmUpMs = PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+
+	TArray<uint64> AcquireSamples;
+	TArray<uint64> ReleaseSamples;
+	AcquireSamples.Reserve(PoolSize * Iterations);
+	ReleaseSamples.Reserve(PoolSize * Iterations);
+
+	double BatchAcquireSeconds = 0.0;
+	double BatchReleaseSeconds = 0.0;
+	int32 NumberOfBatchObjects = 0;
+
+	TArray<UObject*> Objects;
+	Objects.Reserve(PoolSize);
+
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++) {
+		for (int32 i = 0; i < PoolSize; i++) {
+			uint64 StartCycles = FPlatformTime::Cycles64();
+			UObject* Object = AAPoolManager::GetFromPool(PoolManager, Class);
+			AcquireSamples.Add(FPlatformTime::Cycles64() - StartCycles);
+
+			if (Object) {
+				Objects.Add(Object);
+			}
+		}
+
+		for (UObject* Object : Objects) {
+			uint64 StartCycles = FPlatformTime::Cycles64();
+			AAPoolManager::ReturnToPool(PoolManager, Object);
+			ReleaseSamples.Add(FPlatformTime::Cycles64() - StartCycles);
+		}
+		Objects.Reset();
+
+		double StartTime = FPlatformTime::Seconds();
+		Objects = AAPoolManager::GetXFromPool(PoolManager, Class, PoolSize);
+		BatchAcquireSeconds += FPlatformTime::Seconds() - StartTime;
+		NumberOfBatchObjects += Objects.Num();
+
+		StartTime = FPlatformTime::Seconds();
+		AAPoolManager::ReturnMultipleToPool(PoolManager, Objects);
+		BatchReleaseSeconds += FPlatformTime::Seconds() - StartTime;
+		Objects.Reset();
+	}
+
+	FPoolMetrics Metrics;
+	AAPoolManager::GetPoolMetrics(PoolManager, Class, Metrics);
+
+	TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+	Result->SetStringField(TEXT("type"), Class->GetName());
+	Result->SetNumberField(TEXT("poolSize"), PoolSize);
+	Result->SetNumberField(TEXT("warmUpMs"), WarmUpMs);
+	Result->SetObjectField(TEXT("acquire"), MakeLatencyJson(AcquireSamples));
+	Result->SetObjectField(TEXT("release"), MakeLatencyJson(ReleaseSamples));
+	Result->SetObjectField(TEXT("batchAcquire"), MakeBatchJson(BatchAcquireSeconds, NumberOfBatchObjects));
+	Result->SetObjectField(TEXT("batchRelease"), MakeBatchJson(BatchReleaseSeconds, NumberOfBatchObjects));
+	Result->SetNumberField(TEXT("averageRestoreUs"), Metrics.AverageRestoreMs * 1000.0);
+	Result->SetNumberField(TEXT("misses"), Metrics.Misses);
+
+	return Result;
+}
+
+TSharedRef<FJsonObject> UPoolBenchmarkCommandlet::RunGarbageCollectionBenchmark(APoolBenchmarkManager* PoolManager, int32 PoolSize, int32 Iterations) {
+	// Mean time of a full collection in microseconds, the first collection purges the garbage of the previous pools
+	auto MeasureCollection = [Iterations]() {
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++) {
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		}
+
+		TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+		Json->SetNumberField(TEXT("meanUs"), (FPlatformTime::Seconds() - StartTime) * 1000000.0 / Iterations);
+		return Json;
+	};
+
+	TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+	Result->SetStringField(TEXT("type"), TEXT("GarbageCollection"));
+	Result->SetNumberField(TEXT("poolSize"), PoolSize);
+
+	PoolManager->InitializeBenchmarkPools(TArray<FPoolSpecification>());
+	Result->SetObjectField(TEXT("collectWithoutPool"), MeasureCollection());
+
+	FPoolSpecification PoolSpecification;
+	PoolSpecification.Class = UPoolBenchmarkObject::StaticClass();
+	PoolSpecification.NumberOfObjects = PoolSize;
+
+	PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+	Result->SetObjectField(TEXT("collect"), MeasureCollection());
+
+	PoolSpecification.bCreateGCCluster = true;
+	PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+	Result->SetObjectField(TEXT("collectClustered"), MeasureCollection());
+
+	// The first acquire dissolves the cluster, it has to be created again once the pool was idle for a while
+	TArray<UObject*> Objects;
+	for (int32 i = 0; i < PoolSize; i++) {
+		Objects.Add(AAPoolManager::GetFromPool(PoolManager, PoolSpecification.Class));
+	}
+	AAPoolManager::ReturnMultipleToPool(PoolManager, Objects);
+	PoolManager->GetWorld()->Tick(LEVELTICK_All, PoolSpecification.GCClusterIdleTime + 0.1f);
+	Result->SetObjectField(TEXT("collectClusteredAfterUse"), MeasureCollection());
+
+	// Actor pools are never clustered, every actor and its components are visited by each collection
+	PoolSpecification.Class = APoolBenchmarkActor5Components::StaticClass();
+	PoolSpecification.bCreateGCCluster = false;
+	PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+	Result->SetObjectField(TEXT("collectActors"), MeasureCollection());
+
+	PoolManager->InitializeBenchmarkPools(TArray<FPoolSpecification>());
+
+	return Result;
+}
+
+bool UPoolBenchmarkCommandlet::CompareWithBaseline(const TArray<TSharedPtr<FJsonObject>>& Results, const FString& BaselineFile, float Tolerance) {
+	FString BaselineString;
+	FFileHelper::LoadFileToString(BaselineString, *BaselineFile);
+
+	TSharedPtr<FJsonObject> Baseline;
+	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(BaselineString);
+	if (!FJsonSerializer::Deserialize(Reader, Baseline) || !Baseline.IsValid()) {
+		UE_LOG(LogPoolBenchmark, Error, TEXT("Couldn't read the baseline %s"), *BaselineFile);
+		return false;
+	}
+
+	// Baseline results by type and pool size
+	TMap<FString, TSharedPtr<FJsonObject>> BaselineResults;
+	for (auto& Value : Baseline->GetArrayField(TEXT("results"))) {
+		TSharedPtr<FJsonObject> BaselineResult = Value->AsObject();
+		if (BaselineResult.IsValid()) {
+			BaselineResults.Add(FString::Printf(TEXT("%s_%d"), *BaselineResult->GetStringField(TEXT("type")), (int32)BaselineResult->GetNumberField(TEXT("poolSize"))), BaselineResult);
+		}
+	}
+
+	const TCHAR* Measurements[] = { TEXT("acquire"), TEXT("release"), TEXT("batchAcquire"), TEXT("batchRelease"), TEXT("collect"), TEXT("collectClustered"), TEXT("collectClusteredAfterUse"), TEXT("collectActors") };
+
+	bool bPassed = true;
+	for (auto& Result : Results) {
+		FString Key = FString::Printf(TEXT("%s_%d"), *Result->GetStringField(TEXT("type")), (int32)Result->GetNumberField(TEXT("poolSize")));
+		TSharedPtr<FJsonObject>* BaselineResult = BaselineResults.Find(Key);
+		if (!BaselineResult) continue;
+
+		for (const TCHAR* Measurement : Measurements) {
+			const TSharedPtr<FJsonObject>* Current;
+			const TSharedPtr<FJsonObject>* Previous;
+			if (!Result->TryGetObjectField(Measurement, Current) || !(*BaselineResult)->TryGetObjectField(Measurement, Previous)) continue;
+
+			double CurrentMeanUs;
+			double PreviousMeanUs;
+			if (!(*Current)->TryGetNumberField(TEXT("meanUs"), CurrentMeanUs) || !(*Previous)->TryGetNumberField(TEXT("meanUs"), PreviousMeanUs)) continue;
+
+			if (CurrentMeanUs > PreviousMeanUs * (1.0 + Tolerance)) {
+				UE_LOG(LogPoolBenchmark, Error, TEXT("%s %s regressed from %.3fus to %.3fus"), *Key, Measurement, PreviousMeanUs, CurrentMeanUs);
+				bPassed = false;
+			}
+		}
+	}
+
+	return bPassed;
+}
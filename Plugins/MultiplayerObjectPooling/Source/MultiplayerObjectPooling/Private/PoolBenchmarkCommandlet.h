@@ -0,0 +1,41 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PoolBenchmarkCommandlet.generated.h"
+
+class FJsonObject;
+
+/*
+* Measures the acquire and release throughput of the object pools without a level or an editor.
+*
+* UE4Editor-Cmd <Project> -run=PoolBenchmark -nullrhi [-Sizes=100,1000,10000,50000] [-Iterations=3]
+*     [-Output=<File>.json] [-Baseline=<File>.json] [-Tolerance=0.1]
+*
+* The results are written as JSON. The commandlet fails if any request missed the pool. If a baseline is passed,
+* it also fails when the mean latency of any measurement got slower than the baseline by more than the tolerance.
+* The garbage collection results show the time of a full collection with a dormant pool of plain objects,
+* with and without a GC cluster, and with a dormant actor pool, next to the time without any pool.
+*/
+UCLASS()
+class UPoolBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UPoolBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	// Benchmark one pool of the class with the given size
+	TSharedRef<FJsonObject> RunBenchmark(class APoolBenchmarkManager* PoolManager, UClass* Class, int32 PoolSize, int32 Iterations);
+
+	// Measure a full garbage collection with a dormant pool of the given size
+	TSharedRef<FJsonObject> RunGarbageCollectionBenchmark(class APoolBenchmarkManager* PoolManager, int32 PoolSize, int32 Iterations);
+
+	// Returns false if any result is slower than its baseline by more than the tolerance
+	bool CompareWithBaseline(const TArray<TSharedPtr<FJsonObject>>& Results, const FString& BaselineFile, float Tolerance);
+};
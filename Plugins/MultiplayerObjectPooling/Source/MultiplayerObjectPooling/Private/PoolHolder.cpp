@@ -2,163 +2,907 @@
 
 #include "PoolHolder.h"
 #include "Engine.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "HAL/IConsoleManager.h"
 #include "PoolableInterface.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Runtime/Launch/Resources/Version.h"
 
+// The counter channel of the trace exists since 4.25, older engines only see the stat
+#if ENGINE_MAJOR_VERSION > 4 || ENGINE_MINOR_VERSION >= 25
+#include "ProfilingDebugging/CountersTrace.h"
+#define POOL_HAS_TRACE_COUNTERS 1
+#else
+#define POOL_HAS_TRACE_COUNTERS 0
+#endif
+
+// Compiled out by the engine in builds without the cpu profiler trace
+#define POOL_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE(Name)
+
+DECLARE_STATS_GROUP(TEXT("Object Pool"), STATGROUP_ObjectPool, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("Acquire"), STAT_PoolAcquire, STATGROUP_ObjectPool);
+DECLARE_CYCLE_STAT(TEXT("Release"), STAT_PoolRelease, STATGROUP_ObjectPool);
+DECLARE_CYCLE_STAT(TEXT("Restore Actor Settings"), STAT_PoolRestore, STATGROUP_ObjectPool);
+DECLARE_CYCLE_STAT(TEXT("Initialize Pool"), STAT_PoolInitialize, STATGROUP_ObjectPool);
+DECLARE_CYCLE_STAT(TEXT("Fill Pool"), STAT_PoolFill, STATGROUP_ObjectPool);
+DECLARE_CYCLE_STAT(TEXT("Batch Tick"), STAT_PoolBatchTick, STATGROUP_ObjectPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Acquired Objects"), STAT_PoolAcquiredObjects, STATGROUP_ObjectPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Released Objects"), STAT_PoolReleasedObjects, STATGROUP_ObjectPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Misses"), STAT_PoolMisses, STATGROUP_ObjectPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Used Objects"), STAT_PoolUsedObjects, STATGROUP_ObjectPool);
+
+// Used objects of all pools, an accumulator keeps its value across frames. Insights shows the counter as a graph
+#if POOL_HAS_TRACE_COUNTERS
+TRACE_DECLARE_INT_COUNTER(PoolUsedObjects, TEXT("Object Pool/Used Objects"));
+#define POOL_TRACE_USED_OBJECTS(Amount) do { INC_DWORD_STAT_BY(STAT_PoolUsedObjects, Amount); TRACE_COUNTER_ADD(PoolUsedObjects, Amount); } while (0)
+#else
+#define POOL_TRACE_USED_OBJECTS(Amount) INC_DWORD_STAT_BY(STAT_PoolUsedObjects, Amount)
+#endif
+
+// Adds the duration of its scope to a cycle counter of the pool metrics
+struct FPoolCycleScope {
+	uint64& Cycles;
+	uint64 StartCycles;
+
+	FPoolCycleScope(uint64& InCycles) : Cycles(InCycles), StartCycles(FPlatformTime::Cycles64()) {}
+	~FPoolCycleScope() { Cycles += FPlatformTime::Cycles64() - StartCycles; }
+};
+
+bool APoolHolder::HasNativePoolableCallbacks(UClass* Class) {
+	bool bImplementedNatively = false;
+	for (UClass* CurrentClass = Class; CurrentClass != nullptr && !bImplementedNatively; CurrentClass = CurrentClass->GetSuperClass()) {
+		for (const FImplementedInterface& Interface : CurrentClass->Interfaces) {
+			if (Interface.Class->IsChildOf(UPoolableInterface::StaticClass()) && !Interface.bImplementedByK2) {
+				bImplementedNatively = true;
+				break;
+			}
+		}
+	}
+	if (!bImplementedNatively) return false;
+
+	// A Blueprint override is a script function, the native implementation is found otherwise
+	UFunction* BeginPlay = Class->FindFunctionByName(GET_FUNCTION_NAME_CHECKED(IPoolableInterface, PoolableBeginPlay));
+	UFunction* EndPlay = Class->FindFunctionByName(GET_FUNCTION_NAME_CHECKED(IPoolableInterface, PoolableEndPlay));
+
+	return BeginPlay != nullptr && BeginPlay->HasAnyFunctionFlags(FUNC_Native)
+		&& EndPlay != nullptr && EndPlay->HasAnyFunctionFlags(FUNC_Native);
+}
+
+void APoolHolder::CallPoolableInterface(UObject* Object, IPoolableInterface* NativePoolable, bool bIsActive, const EEndPlayReason::Type EndPlayReason) {
+	if (NativePoolable != nullptr) {
+		if (bIsActive) {
+			NativePoolable->PoolableBeginPlay_Implementation();
+		}
+		else {
+			NativePoolable->PoolableEndPlay_Implementation(EndPlayReason);
+		}
+	}
+	else {
+		if (bIsActive) {
+			IPoolableInterface::Execute_PoolableBeginPlay(Object);
+		}
+		else {
+			IPoolableInterface::Execute_PoolableEndPlay(Object, EndPlayReason);
+		}
+	}
+}
 
 APoolHolder::APoolHolder() {
-	PrimaryActorTick.bCanEverTick = false;
+	// Only ticks to return objects whose life span is over and for the batch tick
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	ExpirationsHead = 0;
+	PendingObjects = 0;
+	bParkActors = false;
+	bBatchTick = false;
+	bIsBatchTicking = false;
+	bHasTickingGaps = false;
+	HighWaterMark = 0;
+	IdleHighWaterMark = 0;
+	LastAcquireTime = 0.f;
+	PoolIndex = INDEX_NONE;
+	ClusterRoot = nullptr;
+	InstancedMesh = nullptr;
 	// Add a root component to stick the pool on the pool manager
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootComponent"));
 }
 
 void APoolHolder::Add(UObject* Object) {
-	FString Name = Object->GetName();
-	ObjectPool.Add(Name, Object);
-	AvailableObjects.Add(Name);
+	// The lowest dead slot is reused first, so the slot handles don't depend on the order in which objects were removed
+	int32 SlotHandle = DeadSlots.Num() > 0 ? DeadSlots.Pop(false) : Slots.AddDefaulted();
+	Slots[SlotHandle].Object = Object;
+	// A reused slot still carries the flags of the object which was removed from it
+	Slots[SlotHandle].ActorDirtyFlags = EPoolDirtyFlags::None;
+	ObjectsToSlots.Add(Object, SlotHandle);
+	NamesToSlots.Add(Object->GetFName(), SlotHandle);
 
-	SetObjectActive(Object, false);
+	Slots[SlotHandle].FreeIndex = FreeSlots.Add(SlotHandle);
+	Slots[SlotHandle].NativePoolable = DefaultObjectSettings.bHasNativePoolableCallbacks ? Cast<IPoolableInterface>(Object) : nullptr;
 
-	// Add a timer and ignore the life span for actors with a life span
+	// Cache the components once, a fresh actor matches the default settings so nothing is dirty
+	AActor* Actor = Cast<AActor>(Object);
+	if (Actor != nullptr) {
+		FPoolSlot& Slot = Slots[SlotHandle];
+		Actor->GetComponents<UActorComponent>(Slot.Components);
+		Slot.Components.SetNum(FMath::Min(Slot.Components.Num(), DefaultComponentsSettings.Num()));
+		Slot.ComponentDirtyFlags.Init(EPoolDirtyFlags::None, Slot.Components.Num());
+	}
+
+	SetObjectActive(SlotHandle, false);
+
+	// The pool handles the life span, the actor must not destroy itself
 	if (DefaultObjectSettings.LifeSpan > 0) {
 		Cast<AActor>(Object)->SetLifeSpan(0);
-		ObjectsToTimers.Add(Object, FTimerHandle());
 	}
 }
 
-UObject* APoolHolder::GetUnused() {
-	if (AvailableObjects.Num() > 0) {
-		UObject* UnusedObject = GetSpecificAndSetActive(AvailableObjects[0]);
-		AvailableObjects.RemoveAt(0);
-
-		return UnusedObject;
+UObject* APoolHolder::GetUnused(const FTransform* SpawnTransform) {
+	if (FreeSlots.Num() > 0 || Grow()) {
+		return AcquireSlot(FreeSlots.Last(), SpawnTransform);
 	}
 	else {
+		Counters.Misses++;
+		INC_DWORD_STAT(STAT_PoolMisses);
 		return nullptr;
 	}
 }
 
 TArray<UObject*> APoolHolder::GetAllUnused() {
 	TArray<UObject*> Objects;
-	for (int i = 0; i < AvailableObjects.Num(); i++) {
-		Objects.Add(GetSpecificAndSetActive(AvailableObjects[i]));
+	Objects.Reserve(FreeSlots.Num());
+	while (FreeSlots.Num() > 0) {
+		Objects.Add(AcquireSlot(FreeSlots.Last()));
 	}
-	AvailableObjects.Empty();
 
 	return Objects;
 }
 
-UObject* APoolHolder::GetSpecificAndSetActive(FString ObjectName) {
-	UObject** ObjectFromPool = ObjectPool.Find(ObjectName);
+UObject* APoolHolder::GetSpecific(FString ObjectName, const FTransform* SpawnTransform) {
+	// Only look for existing names, an unknown name can't be a part of the pool
+	FName Name(*ObjectName, FNAME_Find);
+	if (Name == NAME_None) return nullptr;
+
+	int32* SlotHandle = NamesToSlots.Find(Name);
+	if (SlotHandle == nullptr) return nullptr;
+
+	return AcquireSlot(*SlotHandle, SpawnTransform);
+}
+
+int32 APoolHolder::GetUnusedBatch(int32 Quantity, TFunctionRef<void(UObject* Object, int32 Index)> PrepareObject, const FTransform* SpawnTransforms) {
+	if (Quantity <= 0) return 0;
+
+	SCOPE_CYCLE_COUNTER(STAT_PoolAcquire);
+	FScopeCycleCounter PoolCycleCounter(AcquireStatId);
+	POOL_TRACE_SCOPE(ObjectPool_GetUnusedBatch);
+	FPoolCycleScope CycleScope(Counters.AcquireCycles);
+
+	while (FreeSlots.Num() < Quantity && Grow()) {}
+
+	int32 NumberOfObjects = FMath::Min(Quantity, FreeSlots.Num());
+	Counters.Acquires += NumberOfObjects;
+	Counters.Misses += Quantity - NumberOfObjects;
+	INC_DWORD_STAT_BY(STAT_PoolAcquiredObjects, NumberOfObjects);
+	INC_DWORD_STAT_BY(STAT_PoolMisses, Quantity - NumberOfObjects);
+	POOL_TRACE_USED_OBJECTS(NumberOfObjects);
+	if (NumberOfObjects == 0) return 0;
 
-	if (ObjectFromPool == nullptr) return nullptr;
+	// Pop all handles from the top of the free stack at once
+	int32 FirstFreeIndex = FreeSlots.Num() - NumberOfObjects;
+	TArray<int32, TInlineAllocator<128>> SlotHandles;
+	SlotHandles.Append(FreeSlots.GetData() + FirstFreeIndex, NumberOfObjects);
+	FreeSlots.SetNum(FirstFreeIndex, false);
 
-	UObject* UnusedObject = *ObjectFromPool;
+	UpdateHighWaterMarks();
 
-	SetObjectActive(UnusedObject);
+	for (int32 i = 0; i < NumberOfObjects; i++) {
+		Slots[SlotHandles[i]].FreeIndex = INDEX_NONE;
+		ActivateSlot(SlotHandles[i], SpawnTransforms != nullptr ? &SpawnTransforms[i] : nullptr);
+		PrepareObject(Slots[SlotHandles[i]].Object, i);
+	}
+
+	// Every object of the batch is prepared before the first PoolableBeginPlay gets called
+	for (int32 i = 0; i < NumberOfObjects; i++) {
+		NotifyPoolable(SlotHandles[i], true);
+	}
 
-	return UnusedObject;
+	return NumberOfObjects;
 }
 
-UObject* APoolHolder::GetSpecific(FString ObjectName) {
-	// TODO: Bad performance, find a better way
-	AvailableObjects.Remove(ObjectName);
+void APoolHolder::ReturnObjects(TArrayView<UObject*> Objects, const EEndPlayReason::Type EndPlayReason) {
+	SCOPE_CYCLE_COUNTER(STAT_PoolRelease);
+	FScopeCycleCounter PoolCycleCounter(ReleaseStatId);
+	POOL_TRACE_SCOPE(ObjectPool_ReturnObjects);
+	FPoolCycleScope CycleScope(Counters.ReleaseCycles);
 
-	return GetSpecificAndSetActive(ObjectName);
+	TArray<int32, TInlineAllocator<128>> SlotHandles;
+
+	for (UObject* Object : Objects) {
+		int32 SlotHandle = GetSlotHandle(Object);
+		if (SlotHandle == INDEX_NONE) continue;
+
+		// A reserved slot belongs to a worker thread until it spawns the object
+		FPoolSlot& Slot = Slots[SlotHandle];
+		if (Slot.IsAvailable() || Slot.bIsReserved) continue;
+
+		Slot.FreeIndex = FreeSlots.Add(SlotHandle);
+		Slot.LifeSpanId++;
+		SetObjectState(SlotHandle, false);
+		SlotHandles.Add(SlotHandle);
+	}
+
+	Counters.Releases += SlotHandles.Num();
+	INC_DWORD_STAT_BY(STAT_PoolReleasedObjects, SlotHandles.Num());
+	POOL_TRACE_USED_OBJECTS(-SlotHandles.Num());
+
+	for (int32 SlotHandle : SlotHandles) {
+		NotifyPoolable(SlotHandle, false, EndPlayReason);
+	}
+
+	if (DefaultObjectSettings.bIsActor) {
+		for (int32 SlotHandle : SlotHandles) {
+			UpdateDirtyFlags(Slots[SlotHandle]);
+		}
+	}
+
+	ScheduleGCCluster();
+}
+
+UObject* APoolHolder::AcquireSlot(int32 SlotHandle, const FTransform* SpawnTransform) {
+	SCOPE_CYCLE_COUNTER(STAT_PoolAcquire);
+	FScopeCycleCounter PoolCycleCounter(AcquireStatId);
+	POOL_TRACE_SCOPE(ObjectPool_GetUnused);
+	FPoolCycleScope CycleScope(Counters.AcquireCycles);
+
+	// The handle is still in the ring of a worker thread, which may spawn and release the object at any time
+	if (Slots[SlotHandle].bIsReserved) {
+		Counters.Misses++;
+		INC_DWORD_STAT(STAT_PoolMisses);
+		return nullptr;
+	}
+
+	if (Slots[SlotHandle].IsAvailable()) {
+		RemoveFromFreeSlots(SlotHandle);
+		POOL_TRACE_USED_OBJECTS(1);
+	}
+
+	Counters.Acquires++;
+	INC_DWORD_STAT(STAT_PoolAcquiredObjects);
+
+	UpdateHighWaterMarks();
+
+	// The slot reference may become invalid if PoolableBeginPlay grows the pool
+	UObject* Object = Slots[SlotHandle].Object;
+	ActivateSlot(SlotHandle, SpawnTransform);
+	NotifyPoolable(SlotHandle, true);
+
+	return Object;
+}
+
+void APoolHolder::ActivateSlot(int32 SlotHandle, const FTransform* SpawnTransform) {
+	if (ClusterRoot != nullptr) {
+		DissolveGCCluster();
+	}
+
+	FPoolSlot& Slot = Slots[SlotHandle];
+
+	Slot.LifeSpanId++;
+	if (DefaultObjectSettings.LifeSpan > 0) {
+		StartLifeSpan(SlotHandle);
+	}
+
+	SetObjectState(SlotHandle, true, SpawnTransform);
+}
+
+void APoolHolder::UpdateHighWaterMarks() {
+	int32 NumberOfUsedObjects = GetNumberOfUsedObjects();
+	HighWaterMark = FMath::Max(HighWaterMark, NumberOfUsedObjects);
+	IdleHighWaterMark = FMath::Max(IdleHighWaterMark, NumberOfUsedObjects);
+	LastAcquireTime = GetWorld()->GetTimeSeconds();
 }
 
 void APoolHolder::ReturnObject(UObject* Object, const EEndPlayReason::Type EndPlayReason) {
-	FString ObjectName = Object->GetName();
-	AvailableObjects.Add(ObjectName);
+	int32 SlotHandle = GetSlotHandle(Object);
+	if (SlotHandle == INDEX_NONE) return;
+
+	ReleaseSlot(SlotHandle, EndPlayReason);
+}
+
+void APoolHolder::ReleaseSlot(int32 SlotHandle, const EEndPlayReason::Type EndPlayReason) {
+	SCOPE_CYCLE_COUNTER(STAT_PoolRelease);
+	FScopeCycleCounter PoolCycleCounter(ReleaseStatId);
+	POOL_TRACE_SCOPE(ObjectPool_ReturnObject);
+	FPoolCycleScope CycleScope(Counters.ReleaseCycles);
+
+	FPoolSlot& Slot = Slots[SlotHandle];
+
+	// Returning an object twice would hand it out twice, and a reserved slot belongs to a worker thread until it spawns the object
+	if (Slot.IsAvailable() || Slot.bIsReserved) return;
+
+	Counters.Releases++;
+	INC_DWORD_STAT(STAT_PoolReleasedObjects);
+	POOL_TRACE_USED_OBJECTS(-1);
+
+	Slot.FreeIndex = FreeSlots.Add(SlotHandle);
+	// Cancels a pending life span expiration
+	Slot.LifeSpanId++;
 
-	SetObjectActive(Object, false, EndPlayReason);
+	SetObjectActive(SlotHandle, false, EndPlayReason);
+
+	// Collected after PoolableEndPlay, so changes made there are taken into account
+	if (DefaultObjectSettings.bIsActor) {
+		UpdateDirtyFlags(Slots[SlotHandle]);
+	}
+
+	ScheduleGCCluster();
+}
+
+void APoolHolder::RemoveFromFreeSlots(int32 SlotHandle) {
+	int32 FreeIndex = Slots[SlotHandle].FreeIndex;
+	int32 LastHandle = FreeSlots.Last();
+
+	// Move the last handle into the gap, so the stack stays dense
+	FreeSlots[FreeIndex] = LastHandle;
+	Slots[LastHandle].FreeIndex = FreeIndex;
+	FreeSlots.Pop(false);
+
+	Slots[SlotHandle].FreeIndex = INDEX_NONE;
 }
 
-void APoolHolder::SetObjectActive(UObject* Object, bool bIsActive, const EEndPlayReason::Type EndPlayReason) {
+UObject* APoolHolder::CreatePoolObject() {
+	if (DefaultObjectSettings.bIsActor) {
+		return GetWorld()->SpawnActor(Specification.Class);
+	}
+
+	return NewObject<UObject>((UObject*)GetTransientPackage(), Specification.Class);
+}
+
+bool APoolHolder::Grow() {
+	// A pool which is still warming up creates its pending objects on demand instead of missing
+	if (PendingObjects > 0) {
+		Fill(0.0);
+		return true;
+	}
+
+	int32 NumberOfObjects = GetNumberOfObjects();
+	int32 GrowBy = 0;
+
+	switch (Specification.GrowthPolicy) {
+	case EPoolGrowthPolicy::ByCount:
+		GrowBy = Specification.GrowthCount;
+		break;
+	case EPoolGrowthPolicy::ByFactor:
+		GrowBy = FMath::CeilToInt(NumberOfObjects * (Specification.GrowthFactor - 1.f));
+		break;
+	default:
+		return false;
+	}
+
+	GrowBy = FMath::Max(GrowBy, 1);
+	if (Specification.MaxNumberOfObjects > 0) {
+		GrowBy = FMath::Min(GrowBy, Specification.MaxNumberOfObjects - NumberOfObjects - PendingObjects);
+	}
+	// Slot handles have to fit into the network ids
+	GrowBy = FMath::Min(GrowBy, PoolNetId::MaxSlots - Slots.Num() + DeadSlots.Num());
+	if (GrowBy <= 0) return false;
+
+	Counters.SpawnFallbacks += GrowBy;
+	for (int i = 0; i < GrowBy; i++) {
+		Add(CreatePoolObject());
+	}
+
+	return true;
+}
+
+void APoolHolder::Shrink() {
+	// A pool which is still in demand keeps its objects, so steady spawning never trims and regrows it
+	if (GetWorld()->GetTimeSeconds() - LastAcquireTime >= Specification.ShrinkIdleTime) {
+		// Keep enough objects for the busiest moment since the last check
+		int32 TargetNumberOfObjects = FMath::Max3(Specification.MinNumberOfObjects, IdleHighWaterMark, GetNumberOfUsedObjects());
+
+		// The highest slots are removed first, peers which used the same slots keep the same ones
+		if (GetNumberOfObjects() > TargetNumberOfObjects && FreeSlots.Num() > 0) {
+			TArray<int32> RemovableSlots = FreeSlots;
+			RemovableSlots.Sort(TGreater<int32>());
+
+			for (int32 i = 0; i < RemovableSlots.Num() && GetNumberOfObjects() > TargetNumberOfObjects; i++) {
+				RemoveSlot(RemovableSlots[i]);
+			}
+
+			// The removed objects dissolved the cluster, the remaining ones are clustered again
+			ScheduleGCCluster();
+		}
+	}
+
+	IdleHighWaterMark = GetNumberOfUsedObjects();
+}
+
+void APoolHolder::RemoveSlot(int32 SlotHandle) {
+	RemoveFromFreeSlots(SlotHandle);
+
+	FPoolSlot& Slot = Slots[SlotHandle];
+	UObject* Object = Slot.Object;
+
+	// The cluster would keep the removed object alive, so it is dissolved and created again without it
+	if (ClusterRoot != nullptr) {
+		ClusterRoot->Objects.Remove(Object);
+		DissolveGCCluster();
+	}
+
+	ObjectsToSlots.Remove(Object);
+	NamesToSlots.Remove(Object->GetFName());
+
+	if (DefaultObjectSettings.bIsActor) {
+		Cast<AActor>(Object)->Destroy();
+	}
+
+	Slot.Object = nullptr;
+	Slot.LifeSpanId++;
+	Slot.Components.Empty();
+	Slot.ComponentDirtyFlags.Empty();
+
+	// Sorted from the highest to the lowest handle, so Add pops the lowest one
+	DeadSlots.Insert(SlotHandle, Algo::LowerBound(DeadSlots, SlotHandle, TGreater<int32>()));
+}
+
+bool APoolHolder::GrowToSlot(int32 SlotHandle) {
+	if (SlotHandle < 0 || SlotHandle >= PoolNetId::MaxSlots) return false;
+
+	// Objects which are still warming up are created in the same order on every peer
+	while (PendingObjects > 0 && GetObjectBySlot(SlotHandle) == nullptr) {
+		Fill(0.0);
+	}
+
+	if (Specification.GrowthPolicy == EPoolGrowthPolicy::None) return GetObjectBySlot(SlotHandle) != nullptr;
+
+	// Dead slots are filled from the lowest one and new slots are appended, just like the pool of the sender grew
+	while (GetObjectBySlot(SlotHandle) == nullptr) {
+		if (Specification.MaxNumberOfObjects > 0 && GetNumberOfObjects() >= Specification.MaxNumberOfObjects) return false;
+
+		Counters.SpawnFallbacks++;
+		Add(CreatePoolObject());
+	}
+
+	return true;
+}
+
+void APoolHolder::CreateGCCluster() {
+	if (!Specification.bCreateGCCluster || DefaultObjectSettings.bIsActor || ClusterRoot != nullptr) return;
+
+	// A warm up which was finished by acquires already hands out objects
+	if (GetNumberOfUsedObjects() > 0) return;
+
+	// Follow the engine, which only creates clusters while they are enabled
+	IConsoleVariable* CreateGCClusters = IConsoleManager::Get().FindConsoleVariable(TEXT("gc.CreateGCClusters"));
+	if (CreateGCClusters != nullptr && CreateGCClusters->GetInt() == 0) return;
+
+	ClusterRoot = NewObject<UPoolClusterRoot>((UObject*)GetTransientPackage());
+	ClusterRoot->Objects.Reserve(Slots.Num());
+	for (auto& Slot : Slots) {
+		if (Slot.Object != nullptr) {
+			ClusterRoot->Objects.Add(Slot.Object);
+		}
+	}
+	ClusterRoot->CreateCluster();
+}
+
+void APoolHolder::DissolveGCCluster() {
+	// The pool holder still references every object, so nothing gets collected
+	DissolveUObjectCluster(ClusterRoot);
+	ClusterRoot->Objects.Empty();
+	ClusterRoot = nullptr;
+}
+
+void APoolHolder::ScheduleGCCluster() {
+	if (!Specification.bCreateGCCluster || DefaultObjectSettings.bIsActor || ClusterRoot != nullptr) return;
+
+	// A pool which is still warming up creates its cluster when it is filled
+	if (PendingObjects > 0 || GetNumberOfUsedObjects() > 0) return;
+
+	// Every return to zero restarts the timer, CreateGCCluster skips it if objects are used again
+	GetWorldTimerManager().SetTimer(GCClusterTimer, this, &APoolHolder::CreateGCCluster, FMath::Max(Specification.GCClusterIdleTime, 0.01f), false);
+}
+
+void APoolHolder::StartLifeSpan(int32 SlotHandle) {
+	FPoolExpiration Expiration;
+	Expiration.SlotHandle = SlotHandle;
+	Expiration.LifeSpanId = Slots[SlotHandle].LifeSpanId;
+	Expiration.ExpirationTime = GetWorld()->GetTimeSeconds() + DefaultObjectSettings.LifeSpan;
+	Expirations.Add(Expiration);
+
+	if (!IsActorTickEnabled()) {
+		SetActorTickEnabled(true);
+	}
+}
+
+void APoolHolder::Tick(float DeltaSeconds) {
+	Super::Tick(DeltaSeconds);
+
+	ReturnExpiredObjects();
+
+	if (bBatchTick) {
+		TickObjects(DeltaSeconds);
+	}
+
+	// An idle pool doesn't tick, StartLifeSpan and AddToBatchTick enable the tick again
+	if (ExpirationsHead >= Expirations.Num() && TickingObjects.Num() == 0) {
+		SetActorTickEnabled(false);
+	}
+}
+
+void APoolHolder::ReturnExpiredObjects() {
+	float Now = GetWorld()->GetTimeSeconds();
+
+	while (ExpirationsHead < Expirations.Num() && Expirations[ExpirationsHead].ExpirationTime <= Now) {
+		// Copy, returning the object may add new expirations
+		FPoolExpiration Expiration = Expirations[ExpirationsHead++];
+
+		// Skip objects which were returned manually or acquired again in the meantime
+		if (Slots[Expiration.SlotHandle].LifeSpanId != Expiration.LifeSpanId) continue;
+
+		ReleaseSlot(Expiration.SlotHandle, EEndPlayReason::Destroyed);
+	}
+
+	// Drop the handled expirations once they make up half of the queue
+	if (ExpirationsHead > 0 && ExpirationsHead * 2 >= Expirations.Num()) {
+		Expirations.RemoveAt(0, ExpirationsHead, false);
+		ExpirationsHead = 0;
+	}
+}
+
+void APoolHolder::SetObjectActive(int32 SlotHandle, bool bIsActive, const EEndPlayReason::Type EndPlayReason) {
+	SetObjectState(SlotHandle, bIsActive);
+	NotifyPoolable(SlotHandle, bIsActive, EndPlayReason);
+}
+
+void APoolHolder::SetObjectState(int32 SlotHandle, bool bIsActive, const FTransform* SpawnTransform) {
+	if (bBatchTick) {
+		if (bIsActive) {
+			AddToBatchTick(SlotHandle);
+		}
+		else {
+			RemoveFromBatchTick(SlotHandle);
+		}
+	}
+
+	FPoolSlot& Slot = Slots[SlotHandle];
+	UObject* Object = Slot.Object;
 	if (!Object->IsValidLowLevelFast()) return;
 
 	if (DefaultObjectSettings.bIsActor) {
 		AActor* Actor = Cast<AActor>(Object);
 
-		// Attach and detach the actor on the pool for better readability inside the editor
 		if (bIsActive) {
-			RestoreActorSettings(Actor);
-			Actor->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+			RestoreActorSettings(Slot, SpawnTransform != nullptr);
+		}
+
+		if (bParkActors) {
+			SetParkedActorActive(Slot, Actor, bIsActive);
 		}
 		else {
-			Actor->AttachToActor(this, FAttachmentTransformRules::KeepRelativeTransform);
+			// Attach and detach the actor on the pool for better readability inside the editor
+			if (bIsActive) {
+				Actor->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+			}
+			else {
+				Actor->AttachToActor(this, FAttachmentTransformRules::KeepRelativeTransform);
+			}
+
+			Actor->SetActorHiddenInGame(!bIsActive || DefaultObjectSettings.bHiddenInGame);
+			Actor->SetActorEnableCollision(bIsActive);
+		}
+
+		// The only move of the acquire, the root kept the transform it had inside the pool
+		if (bIsActive && SpawnTransform != nullptr) {
+			Actor->SetActorTransform(*SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
+		}
+
+		Actor->SetActorTickEnabled(bIsActive && DefaultObjectSettings.bStartWithTickEnabled && !bBatchTick);
+	}
+}
+
+void APoolHolder::AddToBatchTick(int32 SlotHandle) {
+	FPoolSlot& Slot = Slots[SlotHandle];
+	if (Slot.TickIndex != INDEX_NONE) return;
+
+	IPoolableInterface* Poolable = Cast<IPoolableInterface>(Slot.Object);
+	if (Poolable == nullptr) return;
+
+	FPoolTickEntry Entry;
+	Entry.Poolable = Poolable;
+	Entry.SlotHandle = SlotHandle;
+	Slot.TickIndex = TickingObjects.Add(Entry);
+
+	if (!IsActorTickEnabled()) {
+		SetActorTickEnabled(true);
+	}
+}
+
+void APoolHolder::RemoveFromBatchTick(int32 SlotHandle) {
+	int32 TickIndex = Slots[SlotHandle].TickIndex;
+	if (TickIndex == INDEX_NONE) return;
+
+	Slots[SlotHandle].TickIndex = INDEX_NONE;
+
+	// Moving the last entry into the gap would skip it in the running loop
+	if (bIsBatchTicking) {
+		TickingObjects[TickIndex].Poolable = nullptr;
+		bHasTickingGaps = true;
+		return;
+	}
+
+	TickingObjects.RemoveAtSwap(TickIndex, 1, false);
+	if (TickIndex < TickingObjects.Num()) {
+		Slots[TickingObjects[TickIndex].SlotHandle].TickIndex = TickIndex;
+	}
+}
+
+void APoolHolder::TickObjects(float DeltaSeconds) {
+	if (TickingObjects.Num() == 0) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_PoolBatchTick);
+	POOL_TRACE_SCOPE(ObjectPool_BatchTick);
+
+	// Objects which are acquired during the loop are appended and tick from the next frame on
+	int32 NumberOfObjects = TickingObjects.Num();
+
+	// Destroyed objects are skipped, the garbage collector clears their slots
+	if (Specification.bParallelBatchTick) {
+		ParallelFor(NumberOfObjects, [this, DeltaSeconds](int32 Index) {
+			const FPoolTickEntry& Entry = TickingObjects[Index];
+			if (IsValid(Slots[Entry.SlotHandle].Object)) {
+				Entry.Poolable->PoolableTick(DeltaSeconds);
+			}
+		});
+		return;
+	}
+
+	bIsBatchTicking = true;
+	for (int32 i = 0; i < NumberOfObjects; i++) {
+		const FPoolTickEntry& Entry = TickingObjects[i];
+		if (Entry.Poolable != nullptr && IsValid(Slots[Entry.SlotHandle].Object)) {
+			Entry.Poolable->PoolableTick(DeltaSeconds);
 		}
+	}
+	bIsBatchTicking = false;
+
+	if (bHasTickingGaps) {
+		int32 NumberOfTickingObjects = 0;
+		for (int32 i = 0; i < TickingObjects.Num(); i++) {
+			if (TickingObjects[i].Poolable == nullptr) continue;
 
-		Actor->SetActorHiddenInGame(!bIsActive || DefaultObjectSettings.bHiddenInGame);
-		Actor->SetActorEnableCollision(bIsActive);
-		Actor->SetActorTickEnabled(bIsActive && DefaultObjectSettings.bStartWithTickEnabled);
+			TickingObjects[NumberOfTickingObjects] = TickingObjects[i];
+			Slots[TickingObjects[NumberOfTickingObjects].SlotHandle].TickIndex = NumberOfTickingObjects;
+			NumberOfTickingObjects++;
+		}
+		TickingObjects.SetNum(NumberOfTickingObjects, false);
+		bHasTickingGaps = false;
+	}
+}
+
+void APoolHolder::NotifyPoolable(int32 SlotHandle, bool bIsActive, const EEndPlayReason::Type EndPlayReason) {
+	// Components begin before and end after their actor
+	if (bIsActive && DefaultObjectSettings.bComponentsImplementPoolableInterface) {
+		NotifyPoolableComponents(SlotHandle, true, EndPlayReason);
 	}
 
 	if (DefaultObjectSettings.bImplementsPoolableInterface) {
+		UObject* Object = Slots[SlotHandle].Object;
+		if (Object->IsValidLowLevelFast()) {
+			CallPoolableInterface(Object, Slots[SlotHandle].NativePoolable, bIsActive, EndPlayReason);
+		}
+	}
+
+	if (!bIsActive && DefaultObjectSettings.bComponentsImplementPoolableInterface) {
+		NotifyPoolableComponents(SlotHandle, false, EndPlayReason);
+	}
+}
+
+void APoolHolder::NotifyPoolableComponents(int32 SlotHandle, bool bIsActive, const EEndPlayReason::Type EndPlayReason) {
+	// Index the slot on every iteration, a callback may grow the pool and move the slots
+	for (int i = 0; i < Slots[SlotHandle].Components.Num(); i++) {
+		const FDefaultComponentSettings& ComponentSettings = DefaultComponentsSettings[i];
+		if (!ComponentSettings.bImplementsPoolableInterface) continue;
+
+		UActorComponent* ActorComponent = Slots[SlotHandle].Components[i];
+		if (!IsValid(ActorComponent)) continue;
+
+		IPoolableInterface* NativePoolable = ComponentSettings.bHasNativePoolableCallbacks ? Cast<IPoolableInterface>(ActorComponent) : nullptr;
+		CallPoolableInterface(ActorComponent, NativePoolable, bIsActive, EndPlayReason);
+	}
+}
+
+void APoolHolder::SetParkedActorActive(FPoolSlot& Slot, AActor* Actor, bool bIsActive) {
+	// Only the location changes, hiding or switching off the collision would recreate the render and physics state on every cycle
+	if (!bIsActive) {
+		Actor->SetActorLocation(Specification.ParkingLocation, false, nullptr, ETeleportType::TeleportPhysics);
+
+		// Components like particles and audio stop, the dirty flags activate them again on the next acquire
+		for (int i = 0; i < Slot.Components.Num(); i++) {
+			UActorComponent* ActorComponent = Slot.Components[i];
+			if (IsValid(ActorComponent) && ActorComponent->IsActive()) {
+				ActorComponent->Deactivate();
+				Slot.ComponentDirtyFlags[i] |= EPoolDirtyFlags::Activation;
+			}
+		}
+	}
+
+	// Simulated bodies would fall away from the parking location, so they sleep until the actor is used again
+	for (int i = 0; i < Slot.Components.Num(); i++) {
+		if (!DefaultComponentsSettings[i].bIsSimulatingPhysics) continue;
+
+		UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(Slot.Components[i]);
+		if (!IsValid(PrimitiveComponent)) continue;
+
 		if (bIsActive) {
-			IPoolableInterface::Execute_PoolableBeginPlay(Object);
+			PrimitiveComponent->WakeAllRigidBodies();
 		}
 		else {
-			IPoolableInterface::Execute_PoolableEndPlay(Object, EndPlayReason);
+			PrimitiveComponent->SetAllPhysicsLinearVelocity(FVector::ZeroVector);
+			PrimitiveComponent->SetAllPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+			PrimitiveComponent->PutAllRigidBodiesToSleep();
 		}
 	}
 }
 
-void APoolHolder::RestoreActorSettings(AActor* Actor) {
+void APoolHolder::UpdateDirtyFlags(FPoolSlot& Slot) {
+	AActor* Actor = Cast<AActor>(Slot.Object);
+	if (!Actor->IsValidLowLevelFast()) return;
+
+	// The relative transform of the root component changes when the actor gets attached to or detached from the pool or parked, so it is always restored
+	int32 RootIndex = Slot.Components.Find(Actor->GetRootComponent());
+	if (RootIndex != INDEX_NONE) Slot.ComponentDirtyFlags[RootIndex] |= EPoolDirtyFlags::Transform;
+
+	// Everything else the pool changes is flagged where it happens, only the changes of the gameplay code need the comparison
+	if (!Specification.bDetectChangedSettings) return;
+
+	if (Actor->GetActorTickInterval() != DefaultObjectSettings.TickInterval) Slot.ActorDirtyFlags |= EPoolDirtyFlags::TickInterval;
+	if (Actor->CanBeDamaged() != DefaultObjectSettings.bCanBeDamaged) Slot.ActorDirtyFlags |= EPoolDirtyFlags::Damage;
+
+	for (int i = 0; i < Slot.Components.Num(); i++) {
+		UActorComponent* ActorComponent = Slot.Components[i];
+		if (!IsValid(ActorComponent)) continue;
+
+		Slot.ComponentDirtyFlags[i] |= GetComponentDirtyFlags(ActorComponent, DefaultComponentsSettings[i]);
+	}
+}
+
+uint8 APoolHolder::GetComponentDirtyFlags(UActorComponent* ActorComponent, const FDefaultComponentSettings& ComponentSettings) {
+	uint8 DirtyFlags = EPoolDirtyFlags::None;
+
+	if (ActorComponent->IsComponentTickEnabled() != ComponentSettings.bStartWithTickEnabled) DirtyFlags |= EPoolDirtyFlags::Tick;
+	if (ActorComponent->GetComponentTickInterval() != ComponentSettings.TickInterval) DirtyFlags |= EPoolDirtyFlags::TickInterval;
+	if (ActorComponent->ComponentTags != ComponentSettings.Tags) DirtyFlags |= EPoolDirtyFlags::Tags;
+	if (ActorComponent->IsActive() != ComponentSettings.bAutoActivate) DirtyFlags |= EPoolDirtyFlags::Activation;
+
+	if (ComponentSettings.bIsSceneComponent) {
+		USceneComponent* SceneComponent = Cast<USceneComponent>(ActorComponent);
+		if (SceneComponent->IsValidLowLevelFast()) {
+			if (!SceneComponent->GetRelativeTransform().Equals(ComponentSettings.RelativeTransform)) DirtyFlags |= EPoolDirtyFlags::Transform;
+			if (SceneComponent->GetVisibleFlag() != ComponentSettings.bIsVisible || SceneComponent->bHiddenInGame != ComponentSettings.bIsHidden) DirtyFlags |= EPoolDirtyFlags::Visibility;
+
+			if (ComponentSettings.bIsStaticMeshComponent) {
+				UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(SceneComponent);
+				if (StaticMeshComponent->IsValidLowLevelFast() && StaticMeshComponent->IsSimulatingPhysics() != ComponentSettings.bIsSimulatingPhysics) DirtyFlags |= EPoolDirtyFlags::Physics;
+			}
+		}
+	}
+
+	return DirtyFlags;
+}
+
+void APoolHolder::RestoreActorSettings(FPoolSlot& Slot, bool bKeepRootTransform) {
+	SCOPE_CYCLE_COUNTER(STAT_PoolRestore);
+	FScopeCycleCounter PoolCycleCounter(RestoreStatId);
+	POOL_TRACE_SCOPE(ObjectPool_RestoreActorSettings);
+	FPoolCycleScope CycleScope(Counters.RestoreCycles);
+	Counters.Restores++;
+
+	AActor* Actor = Cast<AActor>(Slot.Object);
+
 	// Restore default settings
-	Actor->SetActorTickInterval(DefaultObjectSettings.TickInterval);
-	Actor->bCanBeDamaged = DefaultObjectSettings.bCanBeDamaged;
-	if (DefaultObjectSettings.LifeSpan > 0) {
-		FTimerHandle* Timer = ObjectsToTimers.Find(Actor);
-		FTimerDelegate TimerDel;
-		TimerDel.BindUFunction(this, FName("ReturnObject"), Actor, EEndPlayReason::Destroyed);
-		GetWorldTimerManager().SetTimer(*Timer, TimerDel, DefaultObjectSettings.LifeSpan, false);
-	}
-
-	// Restore default components settings
-	if (DefaultComponentsSettings.Num() > 0) {
-		TArray<UActorComponent*> ActorComponents;
-		Actor->GetComponents<UActorComponent>(ActorComponents);
-
-		for (int i = 0; i < ActorComponents.Num(); i++) {
-			if (i >= DefaultComponentsSettings.Num()) return;
-
-			// Restore actor component settings
-			UActorComponent* ActorComponent = ActorComponents[i];
-			FDefaultComponentSettings ComponentSettings = DefaultComponentsSettings[i];
-
-			ActorComponent->SetComponentTickEnabled(ComponentSettings.bStartWithTickEnabled);
-			ActorComponent->SetComponentTickInterval(ComponentSettings.TickInterval);
-			ActorComponent->ComponentTags = ComponentSettings.Tags;
-			ActorComponent->SetActive(ComponentSettings.bAutoActivate);
-
-			// Restore scene component settings
-			if (ComponentSettings.bIsSceneComponent) {
-				USceneComponent* SceneComponent = Cast<USceneComponent>(ActorComponent);
-				if (SceneComponent->IsValidLowLevelFast()) {
-					SceneComponent->SetRelativeTransform(ComponentSettings.RelativeTransform, false, nullptr, ETeleportType::TeleportPhysics);
-					SceneComponent->SetVisibility(ComponentSettings.bIsVisible);
-					SceneComponent->SetHiddenInGame(ComponentSettings.bIsHidden);
-
-					// Restore static mesh component settings
-					if (ComponentSettings.bIsStaticMeshComponent) {
-						UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(SceneComponent);
-						if (StaticMeshComponent->IsValidLowLevelFast()) {
-							StaticMeshComponent->SetSimulatePhysics(ComponentSettings.bIsSimulatingPhysics);
-						}
-					}
+	if (Slot.ActorDirtyFlags & EPoolDirtyFlags::TickInterval) Actor->SetActorTickInterval(DefaultObjectSettings.TickInterval);
+	if (Slot.ActorDirtyFlags & EPoolDirtyFlags::Damage) Actor->SetCanBeDamaged(DefaultObjectSettings.bCanBeDamaged);
+	Slot.ActorDirtyFlags = EPoolDirtyFlags::None;
+
+	USceneComponent* RootComponent = bKeepRootTransform ? Actor->GetRootComponent() : nullptr;
+
+	// Restore default components settings, only for the components which changed since the last acquire
+	for (int i = 0; i < Slot.Components.Num(); i++) {
+		uint8 DirtyFlags = Slot.ComponentDirtyFlags[i];
+		if (DirtyFlags == EPoolDirtyFlags::None) continue;
+
+		Slot.ComponentDirtyFlags[i] = EPoolDirtyFlags::None;
+
+		UActorComponent* ActorComponent = Slot.Components[i];
+		if (!IsValid(ActorComponent)) continue;
+
+		if (ActorComponent == RootComponent) DirtyFlags &= (uint8)~EPoolDirtyFlags::Transform;
+
+		RestoreComponentSettings(ActorComponent, DefaultComponentsSettings[i], DirtyFlags);
+	}
+}
+
+void APoolHolder::RestoreComponentSettings(UActorComponent* ActorComponent, const FDefaultComponentSettings& ComponentSettings, uint8 DirtyFlags) {
+	// Restore actor component settings
+	if (DirtyFlags & EPoolDirtyFlags::Tick) ActorComponent->SetComponentTickEnabled(ComponentSettings.bStartWithTickEnabled);
+	if (DirtyFlags & EPoolDirtyFlags::TickInterval) ActorComponent->SetComponentTickInterval(ComponentSettings.TickInterval);
+	if (DirtyFlags & EPoolDirtyFlags::Tags) ActorComponent->ComponentTags = ComponentSettings.Tags;
+	if (DirtyFlags & EPoolDirtyFlags::Activation) ActorComponent->SetActive(ComponentSettings.bAutoActivate);
+
+	// Restore scene component settings
+	if (ComponentSettings.bIsSceneComponent) {
+		USceneComponent* SceneComponent = Cast<USceneComponent>(ActorComponent);
+		if (SceneComponent->IsValidLowLevelFast()) {
+			if (DirtyFlags & EPoolDirtyFlags::Transform) SceneComponent->SetRelativeTransform(ComponentSettings.RelativeTransform, false, nullptr, ETeleportType::TeleportPhysics);
+			if (DirtyFlags & EPoolDirtyFlags::Visibility) {
+				SceneComponent->SetVisibility(ComponentSettings.bIsVisible);
+				SceneComponent->SetHiddenInGame(ComponentSettings.bIsHidden);
+			}
+
+			// Restore static mesh component settings
+			if (DirtyFlags & EPoolDirtyFlags::Physics) {
+				UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(SceneComponent);
+				if (StaticMeshComponent->IsValidLowLevelFast()) {
+					StaticMeshComponent->SetSimulatePhysics(ComponentSettings.bIsSimulatingPhysics);
 				}
 			}
 		}
 	}
 }
 
-void APoolHolder::InitializePool(FPoolSpecification PoolSpecification) {
+void APoolHolder::InitializePool(FPoolSpecification PoolSpecification, bool bDeferFill) {
+	SCOPE_CYCLE_COUNTER(STAT_PoolInitialize);
+	POOL_TRACE_SCOPE(ObjectPool_InitializePool);
+
+	Specification = PoolSpecification;
+
+	if (PoolSpecification.AsyncReservations > 0) {
+		AsyncQueue = MakeShared<FPoolAsyncQueue, ESPMode::ThreadSafe>(PoolIndex, PoolSpecification.AsyncReservations);
+	}
+
+#if STATS
+	if (PoolSpecification.Class) {
+		FString ClassName = PoolSpecification.Class->GetName();
+		AcquireStatId = FDynamicStats::CreateStatId<FStatGroup_STATGROUP_ObjectPool>(FString::Printf(TEXT("Acquire %s"), *ClassName));
+		ReleaseStatId = FDynamicStats::CreateStatId<FStatGroup_STATGROUP_ObjectPool>(FString::Printf(TEXT("Release %s"), *ClassName));
+		RestoreStatId = FDynamicStats::CreateStatId<FStatGroup_STATGROUP_ObjectPool>(FString::Printf(TEXT("Restore %s"), *ClassName));
+	}
+#endif
+
+	switch (PoolSpecification.DormancyMode) {
+	case EPoolDormancyMode::Attach:
+		bParkActors = false;
+		break;
+	case EPoolDormancyMode::Park:
+		bParkActors = true;
+		break;
+	default:
+		bParkActors = false;
+		break;
+	}
+
 	TSubclassOf<UObject> Class = PoolSpecification.Class;
 	int32 NumberOfObjects = PoolSpecification.NumberOfObjects;
+	if (PoolSpecification.MaxNumberOfObjects > 0) {
+		NumberOfObjects = FMath::Min(NumberOfObjects, PoolSpecification.MaxNumberOfObjects);
+	}
 
 	if (Class) {
 		// Save the default object settings
 		DefaultObjectSettings.bImplementsPoolableInterface = Class->ImplementsInterface(UPoolableInterface::StaticClass());
+		DefaultObjectSettings.bHasNativePoolableCallbacks = DefaultObjectSettings.bImplementsPoolableInterface && HasNativePoolableCallbacks(Class);
+
+		// PoolableTick is native only, so the interface has to be implemented in C++
+		if (PoolSpecification.bBatchTick) {
+			bBatchTick = Cast<IPoolableInterface>(Class->GetDefaultObject()) != nullptr;
+			if (!bBatchTick) {
+				UE_LOG(LogTemp, Error, TEXT("%s doesn't implement the poolable interface in C++, its pool can't use a batch tick!"), *Class->GetName());
+			}
+		}
 
 		// Save the default actor settings
 		if (Class->IsChildOf(AActor::StaticClass())) {
@@ -166,73 +910,438 @@ void APoolHolder::InitializePool(FPoolSpecification PoolSpecification) {
 			DefaultObjectSettings.bIsActor = true;
 			DefaultObjectSettings.bStartWithTickEnabled = DefaultActor->IsActorTickEnabled();
 			DefaultObjectSettings.TickInterval = DefaultActor->GetActorTickInterval();
-			DefaultObjectSettings.bHiddenInGame = DefaultActor->bHidden;
+			DefaultObjectSettings.bHiddenInGame = DefaultActor->IsHidden();
 			DefaultObjectSettings.LifeSpan = DefaultActor->InitialLifeSpan;
-			DefaultObjectSettings.bCanBeDamaged = DefaultActor->bCanBeDamaged;
+			DefaultObjectSettings.bCanBeDamaged = DefaultActor->CanBeDamaged();
 			
 			// Save the default component settings
 			TArray<UActorComponent*> ActorComponents;
 			DefaultActor->GetComponents<UActorComponent>(ActorComponents);
 			for (int i = 0; i < ActorComponents.Num(); i++) {
-				FDefaultComponentSettings DefaultComponentSettings;
-				DefaultComponentSettings.bImplementsPoolableInterface = ActorComponents[i]->GetClass()->ImplementsInterface(UPoolableInterface::StaticClass());
-				DefaultComponentSettings.bStartWithTickEnabled = ActorComponents[i]->IsComponentTickEnabled();
-				DefaultComponentSettings.TickInterval = ActorComponents[i]->GetComponentTickInterval();
-				DefaultComponentSettings.Tags = ActorComponents[i]->ComponentTags;
-				DefaultComponentSettings.bAutoActivate = ActorComponents[i]->bAutoActivate;
-
-				// Check for scene component settings
-				USceneComponent* SceneComponent = Cast<USceneComponent>(ActorComponents[i]);
-				if (SceneComponent->IsValidLowLevelFast()) {
-					DefaultComponentSettings.bIsSceneComponent = true;
-					DefaultComponentSettings.RelativeTransform = SceneComponent->GetRelativeTransform();
-					DefaultComponentSettings.bIsVisible = SceneComponent->bVisible;
-					DefaultComponentSettings.bIsHidden = SceneComponent->bHiddenInGame;
-
-					// Check for static mesh component settings
-					UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(ActorComponents[i]);
-					if (StaticMeshComponent->IsValidLowLevelFast()) {
-						DefaultComponentSettings.bIsStaticMeshComponent = true;
-						DefaultComponentSettings.bIsSimulatingPhysics = StaticMeshComponent->IsSimulatingPhysics();
-					}
-				}
-
+				FDefaultComponentSettings DefaultComponentSettings = SaveComponentSettings(ActorComponents[i]);
+				DefaultObjectSettings.bComponentsImplementPoolableInterface |= DefaultComponentSettings.bImplementsPoolableInterface;
 				DefaultComponentsSettings.Add(DefaultComponentSettings);
 			}
-			DefaultActor->Destroy();
-			
-			for (int i = 0; i < NumberOfObjects; i++) {
-				AActor* NewActor = GetWorld()->SpawnActor(Class);
-				Add(NewActor);
+
+			if (PoolSpecification.bUseInstancedMesh) {
+				CreateInstancedMesh(DefaultActor);
 			}
+			DefaultActor->Destroy();
 		}
-		else {
-			for (int i = 0; i < NumberOfObjects; i++) {
-				Add(NewObject<UObject>((UObject*)GetTransientPackage(), Class));
-			}
+
+		PendingObjects = NumberOfObjects;
+		if (!bDeferFill) {
+			Fill(TNumericLimits<double>::Max());
 		}
 	}
 }
 
+FDefaultComponentSettings APoolHolder::SaveComponentSettings(UActorComponent* ActorComponent) {
+	FDefaultComponentSettings DefaultComponentSettings;
+	DefaultComponentSettings.bImplementsPoolableInterface = ActorComponent->GetClass()->ImplementsInterface(UPoolableInterface::StaticClass());
+	DefaultComponentSettings.bHasNativePoolableCallbacks = DefaultComponentSettings.bImplementsPoolableInterface && HasNativePoolableCallbacks(ActorComponent->GetClass());
+	DefaultComponentSettings.bStartWithTickEnabled = ActorComponent->IsComponentTickEnabled();
+	DefaultComponentSettings.TickInterval = ActorComponent->GetComponentTickInterval();
+	DefaultComponentSettings.Tags = ActorComponent->ComponentTags;
+	DefaultComponentSettings.bAutoActivate = ActorComponent->bAutoActivate;
+
+	// Check for scene component settings
+	USceneComponent* SceneComponent = Cast<USceneComponent>(ActorComponent);
+	if (SceneComponent->IsValidLowLevelFast()) {
+		DefaultComponentSettings.bIsSceneComponent = true;
+		DefaultComponentSettings.RelativeTransform = SceneComponent->GetRelativeTransform();
+		DefaultComponentSettings.bIsVisible = SceneComponent->GetVisibleFlag();
+		DefaultComponentSettings.bIsHidden = SceneComponent->bHiddenInGame;
+
+		// Check for static mesh component settings
+		UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(ActorComponent);
+		if (StaticMeshComponent->IsValidLowLevelFast()) {
+			DefaultComponentSettings.bIsStaticMeshComponent = true;
+			DefaultComponentSettings.bIsSimulatingPhysics = StaticMeshComponent->IsSimulatingPhysics();
+		}
+	}
+
+	return DefaultComponentSettings;
+}
+
+bool APoolHolder::Fill(double EndTime) {
+	if (PendingObjects <= 0) return true;
+
+	SCOPE_CYCLE_COUNTER(STAT_PoolFill);
+	POOL_TRACE_SCOPE(ObjectPool_Fill);
+
+	do {
+		Add(CreatePoolObject());
+		PendingObjects--;
+	} while (PendingObjects > 0 && FPlatformTime::Seconds() < EndTime);
+
+	if (PendingObjects > 0) return false;
+
+	CreateGCCluster();
+
+	// Start shrinking after the pool is filled, otherwise the warm up would be undone
+	if (Specification.ShrinkIdleTime > 0) {
+		GetWorldTimerManager().SetTimer(ShrinkTimer, this, &APoolHolder::Shrink, Specification.ShrinkIdleTime, true);
+	}
+
+	return true;
+}
+
+bool APoolHolder::IsFilled() const {
+	return PendingObjects <= 0;
+}
+
+TSubclassOf<UObject> APoolHolder::GetPoolClass() const {
+	return Specification.Class;
+}
+
+const FPoolSpecification& APoolHolder::GetSpecification() const {
+	return Specification;
+}
+
 int32 APoolHolder::GetNumberOfUsedObjects() {
-	return ObjectPool.Num() - AvailableObjects.Num();
+	return GetNumberOfObjects() - FreeSlots.Num();
 }
 
 int32 APoolHolder::GetNumberOfAvailableObjects() {
-	return AvailableObjects.Num();
+	return FreeSlots.Num();
+}
+
+int32 APoolHolder::GetNumberOfObjects() {
+	return Slots.Num() - DeadSlots.Num();
+}
+
+int32 APoolHolder::GetHighWaterMark() {
+	return HighWaterMark;
+}
+
+FPoolMetrics APoolHolder::GetMetrics() {
+	FPoolMetrics Metrics;
+	Metrics.NumberOfObjects = GetNumberOfObjects();
+	Metrics.NumberOfUsedObjects = GetNumberOfUsedObjects();
+	Metrics.HighWaterMark = HighWaterMark;
+	Metrics.Acquires = (int32)FMath::Min<uint64>(Counters.Acquires, MAX_int32);
+	Metrics.Releases = (int32)FMath::Min<uint64>(Counters.Releases, MAX_int32);
+	Metrics.Misses = (int32)FMath::Min<uint64>(Counters.Misses, MAX_int32);
+	Metrics.SpawnFallbacks = (int32)FMath::Min<uint64>(Counters.SpawnFallbacks, MAX_int32);
+	Metrics.NumberOfInstances = InstancedMesh != nullptr ? InstancedMesh->GetInstanceCount() : 0;
+	Metrics.NumberOfUsedInstances = GetNumberOfUsedInstances();
+	Metrics.InstanceAcquires = (int32)FMath::Min<uint64>(Counters.InstanceAcquires, MAX_int32);
+	Metrics.InstanceReleases = (int32)FMath::Min<uint64>(Counters.InstanceReleases, MAX_int32);
+
+	if (Counters.Acquires > 0) Metrics.AverageAcquireMs = FPlatformTime::ToMilliseconds64(Counters.AcquireCycles) / Counters.Acquires;
+	if (Counters.Releases > 0) Metrics.AverageReleaseMs = FPlatformTime::ToMilliseconds64(Counters.ReleaseCycles) / Counters.Releases;
+	if (Counters.Restores > 0) Metrics.AverageRestoreMs = FPlatformTime::ToMilliseconds64(Counters.RestoreCycles) / Counters.Restores;
+
+	return Metrics;
 }
 
 bool APoolHolder::IsObjectAvailable(UObject* Object) {
-	return AvailableObjects.Contains(Object->GetName());
+	int32 SlotHandle = GetSlotHandle(Object);
+	if (SlotHandle == INDEX_NONE) return false;
+
+	return Slots[SlotHandle].IsAvailable();
+}
+
+int32 APoolHolder::GetSlotHandle(UObject* Object) const {
+	const int32* SlotHandle = ObjectsToSlots.Find(Object);
+
+	return SlotHandle != nullptr ? *SlotHandle : INDEX_NONE;
+}
+
+UObject* APoolHolder::GetObjectBySlot(int32 SlotHandle) const {
+	if (!Slots.IsValidIndex(SlotHandle)) return nullptr;
+
+	return Slots[SlotHandle].Object;
+}
+
+UObject* APoolHolder::GetSpecificBySlot(int32 SlotHandle, const FTransform* SpawnTransform) {
+	// The pool of the sender may have grown or kept objects which were removed here by shrinking
+	if (GetObjectBySlot(SlotHandle) == nullptr && !GrowToSlot(SlotHandle)) return nullptr;
+
+	return AcquireSlot(SlotHandle, SpawnTransform);
+}
+
+void APoolHolder::SetPoolIndex(int32 NewPoolIndex) {
+	PoolIndex = NewPoolIndex;
+}
+
+int32 APoolHolder::GetPoolIndex() const {
+	return PoolIndex;
+}
+
+int32 APoolHolder::GetNetId(UObject* Object) const {
+	if (PoolIndex == INDEX_NONE) return INDEX_NONE;
+
+	int32 SlotHandle = GetSlotHandle(Object);
+	if (SlotHandle == INDEX_NONE) return INDEX_NONE;
+
+	return PoolNetId::Make(PoolIndex, SlotHandle);
+}
+
+TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> APoolHolder::GetAsyncQueue() const {
+	return AsyncQueue;
+}
+
+void APoolHolder::ProcessAsyncRequests() {
+	if (!AsyncQueue.IsValid()) return;
+
+	POOL_TRACE_SCOPE(ObjectPool_ProcessAsyncRequests);
+
+	TArray<FPoolAsyncRequest, TInlineAllocator<64>> Spawns;
+	TArray<FPoolAsyncRequest, TInlineAllocator<64>> Releases;
+
+	FPoolAsyncRequest Request;
+	while (AsyncQueue->Dequeue(Request)) {
+		if (GetObjectBySlot(Request.SlotHandle) == nullptr) continue;
+
+		// Validated after the spawns were activated, a worker may release an object it spawned in the same frame
+		if (Request.bRelease) {
+			Releases.Add(Request);
+			continue;
+		}
+
+		// The spawn moves the life span id on by one, which the handle of the reservation already carries
+		FPoolSlot& Slot = Slots[Request.SlotHandle];
+		if (Slot.bIsReserved && PoolAsyncHandle::Matches(Request.Generation, Slot.LifeSpanId + 1)) {
+			Slot.bIsReserved = false;
+			Spawns.Add(Request);
+		}
+	}
+
+	// Spawns first, so the releases see the life span ids of the activated objects
+	if (Spawns.Num() > 0) {
+		SCOPE_CYCLE_COUNTER(STAT_PoolAcquire);
+		FScopeCycleCounter PoolCycleCounter(AcquireStatId);
+		FPoolCycleScope CycleScope(Counters.AcquireCycles);
+
+		Counters.Acquires += Spawns.Num();
+		INC_DWORD_STAT_BY(STAT_PoolAcquiredObjects, Spawns.Num());
+
+		// Reserved objects already count as used
+		UpdateHighWaterMarks();
+
+		for (auto& Spawn : Spawns) {
+			ActivateSlot(Spawn.SlotHandle, Spawn.bHasTransform ? &Spawn.Transform : nullptr);
+		}
+
+		for (auto& Spawn : Spawns) {
+			NotifyPoolable(Spawn.SlotHandle, true);
+		}
+	}
+
+	// Runs of the same end play reason are returned together
+	TArray<UObject*, TInlineAllocator<64>> Run;
+	for (int32 i = 0; i < Releases.Num(); i++) {
+		FPoolSlot& Slot = Slots[Releases[i].SlotHandle];
+
+		// A handle of an object which was released in the meantime is stale
+		uint32 LifeSpanId = Slot.bIsReserved ? Slot.LifeSpanId + 1 : Slot.LifeSpanId;
+		if (PoolAsyncHandle::Matches(Releases[i].Generation, LifeSpanId)) {
+			// Reserved objects were never activated, so they only go back onto the free stack. The life span id moves on
+			// like after a spawn, otherwise the next reservation of the slot would accept the handle of this one
+			if (Slot.bIsReserved) {
+				Slot.bIsReserved = false;
+				Slot.LifeSpanId++;
+				Slot.FreeIndex = FreeSlots.Add(Releases[i].SlotHandle);
+				POOL_TRACE_USED_OBJECTS(-1);
+			}
+			else if (!Slot.IsAvailable()) {
+				Run.Add(Slot.Object);
+			}
+		}
+
+		if (Run.Num() > 0 && (i + 1 == Releases.Num() || Releases[i + 1].EndPlayReason != Releases[i].EndPlayReason)) {
+			ReturnObjects(Run, Releases[i].EndPlayReason);
+			Run.Reset();
+		}
+	}
+
+	// Restock the reservations for the next frame
+	while (AsyncQueue->GetNumberOfReservations() < Specification.AsyncReservations && (FreeSlots.Num() > 0 || Grow())) {
+		int32 SlotHandle = FreeSlots.Last();
+		if (!AsyncQueue->AddReservation(PoolAsyncHandle::Make(SlotHandle, Slots[SlotHandle].LifeSpanId + 1))) break;
+
+		RemoveFromFreeSlots(SlotHandle);
+		Slots[SlotHandle].bIsReserved = true;
+		POOL_TRACE_USED_OBJECTS(1);
+	}
+}
+
+bool APoolHolder::IsInstanced() const {
+	return InstancedMesh != nullptr;
+}
+
+void APoolHolder::CreateInstancedMesh(AActor* DefaultActor) {
+	UStaticMeshComponent* MeshComponent = DefaultActor->FindComponentByClass<UStaticMeshComponent>();
+	if (MeshComponent == nullptr || MeshComponent->GetStaticMesh() == nullptr) {
+		UE_LOG(LogTemp, Error, TEXT("%s has no static mesh, its pool can't use an instanced mesh!"), *DefaultActor->GetClass()->GetName());
+		return;
+	}
+
+	UClass* MeshClass = Specification.bUseHierarchicalInstances ? UHierarchicalInstancedStaticMeshComponent::StaticClass() : UInstancedStaticMeshComponent::StaticClass();
+	InstancedMesh = NewObject<UInstancedStaticMeshComponent>(this, MeshClass);
+	InstancedMesh->SetMobility(EComponentMobility::Movable);
+	InstancedMesh->SetStaticMesh(MeshComponent->GetStaticMesh());
+	for (int32 i = 0; i < MeshComponent->GetNumMaterials(); i++) {
+		InstancedMesh->SetMaterial(i, MeshComponent->GetMaterial(i));
+	}
+	InstancedMesh->SetCastShadow(MeshComponent->CastShadow);
+	// Instances are visual only, gameplay which needs collision materializes the instance
+	InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstancedMesh->SetupAttachment(RootComponent);
+	InstancedMesh->RegisterComponent();
+
+	// The mesh component may be attached to other components of the actor
+	InstanceMeshTransform = MeshComponent->GetComponentTransform().GetRelativeTransform(DefaultActor->GetActorTransform());
+
+	AddInstances(Specification.NumberOfInstances);
+}
+
+// Unused instances are shrunk at the parking location. Not zero, the renderer has to invert the instance transforms
+static FTransform GetHiddenInstanceTransform(const FVector& ParkingLocation) {
+	return FTransform(FQuat::Identity, ParkingLocation, FVector(KINDA_SMALL_NUMBER));
+}
+
+bool APoolHolder::AddInstances(int32 Quantity) {
+	if (InstancedMesh == nullptr) return false;
+
+	if (Specification.MaxNumberOfInstances > 0) {
+		Quantity = FMath::Min(Quantity, Specification.MaxNumberOfInstances - InstancedMesh->GetInstanceCount());
+	}
+	if (Quantity <= 0) return false;
+
+	// The instances are never removed, so their indices stay valid
+	FTransform HiddenTransform = GetHiddenInstanceTransform(Specification.ParkingLocation);
+	FreeInstances.Reserve(FreeInstances.Num() + Quantity);
+	for (int32 i = 0; i < Quantity; i++) {
+		int32 Instance = InstancedMesh->AddInstanceWorldSpace(HiddenTransform);
+		while (UsedInstances.Num() <= Instance) {
+			UsedInstances.Add(false);
+		}
+		FreeInstances.Add(Instance);
+	}
+
+	return true;
+}
+
+bool APoolHolder::IsInstanceUsed(int32 Instance) const {
+	return Instance >= 0 && Instance < UsedInstances.Num() && UsedInstances[Instance];
+}
+
+int32 APoolHolder::AcquireInstances(TArrayView<const FTransform> Transforms, TArray<int32>& Instances) {
+	Instances.Reset(Transforms.Num());
+	if (InstancedMesh == nullptr) return 0;
+
+	SCOPE_CYCLE_COUNTER(STAT_PoolAcquire);
+	POOL_TRACE_SCOPE(ObjectPool_AcquireInstances);
+
+	// Double the instances, but at least add enough for the whole batch
+	int32 MissingInstances = Transforms.Num() - FreeInstances.Num();
+	if (MissingInstances > 0) {
+		AddInstances(FMath::Max(MissingInstances, InstancedMesh->GetInstanceCount()));
+	}
+
+	int32 NumberOfInstances = 0;
+	for (const FTransform& Transform : Transforms) {
+		if (FreeInstances.Num() == 0) {
+			Instances.Add(INDEX_NONE);
+			continue;
+		}
+
+		int32 Instance = FreeInstances.Pop(false);
+		UsedInstances[Instance] = true;
+		InstancedMesh->UpdateInstanceTransform(Instance, InstanceMeshTransform * Transform, true, false, true);
+		Instances.Add(Instance);
+		NumberOfInstances++;
+	}
+
+	Counters.InstanceAcquires += NumberOfInstances;
+	Counters.Misses += Transforms.Num() - NumberOfInstances;
+	INC_DWORD_STAT_BY(STAT_PoolMisses, Transforms.Num() - NumberOfInstances);
+
+	// One render state update for the whole batch
+	if (NumberOfInstances > 0) {
+		InstancedMesh->MarkRenderStateDirty();
+	}
+
+	return NumberOfInstances;
+}
+
+void APoolHolder::UpdateInstances(TArrayView<const int32> Instances, TArrayView<const FTransform> Transforms) {
+	if (InstancedMesh == nullptr) return;
+
+	bool bUpdated = false;
+	int32 NumberOfInstances = FMath::Min(Instances.Num(), Transforms.Num());
+	for (int32 i = 0; i < NumberOfInstances; i++) {
+		if (!IsInstanceUsed(Instances[i])) continue;
+
+		InstancedMesh->UpdateInstanceTransform(Instances[i], InstanceMeshTransform * Transforms[i], true, false, true);
+		bUpdated = true;
+	}
+
+	if (bUpdated) {
+		InstancedMesh->MarkRenderStateDirty();
+	}
+}
+
+void APoolHolder::ReleaseInstances(TArrayView<const int32> Instances) {
+	if (InstancedMesh == nullptr) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_PoolRelease);
+	POOL_TRACE_SCOPE(ObjectPool_ReleaseInstances);
+
+	FTransform HiddenTransform = GetHiddenInstanceTransform(Specification.ParkingLocation);
+	bool bUpdated = false;
+	for (int32 Instance : Instances) {
+		if (!IsInstanceUsed(Instance)) continue;
+
+		UsedInstances[Instance] = false;
+		InstancedMesh->UpdateInstanceTransform(Instance, HiddenTransform, true, false, true);
+		FreeInstances.Add(Instance);
+		Counters.InstanceReleases++;
+		bUpdated = true;
+	}
+
+	if (bUpdated) {
+		InstancedMesh->MarkRenderStateDirty();
+	}
+}
+
+AActor* APoolHolder::MaterializeInstance(int32 Instance) {
+	if (!IsInstanceUsed(Instance)) return nullptr;
+
+	// The instance transform is the mesh transform on top of the actor transform
+	FTransform InstanceTransform;
+	InstancedMesh->GetInstanceTransform(Instance, InstanceTransform, true);
+	FTransform ActorTransform = InstanceMeshTransform.Inverse() * InstanceTransform;
+
+	AActor* Actor = nullptr;
+	GetUnusedBatch(1, [&](UObject* Object, int32 Index) {
+		Actor = (AActor*)Object;
+	}, &ActorTransform);
+
+	// The instance stays if there is no actor to replace it
+	if (Actor != nullptr) {
+		ReleaseInstances(MakeArrayView(&Instance, 1));
+	}
+
+	return Actor;
+}
+
+int32 APoolHolder::GetNumberOfUsedInstances() const {
+	if (InstancedMesh == nullptr) return 0;
+
+	return InstancedMesh->GetInstanceCount() - FreeInstances.Num();
 }
 
 void APoolHolder::Destroyed() {
 	if (DefaultObjectSettings.bIsActor) {
-		TArray<UObject*> Pool;
-		ObjectPool.GenerateValueArray(Pool);
-		for (auto& Object : Pool) {
-			AActor* Actor = Cast<AActor>(Object);
-			Actor->Destroy();
+		for (auto& Slot : Slots) {
+			AActor* Actor = Cast<AActor>(Slot.Object);
+			if (IsValid(Actor)) {
+				Actor->Destroy();
+			}
 		}
 	}
 
@@ -242,16 +1351,32 @@ void APoolHolder::Destroyed() {
 		Actor->Destroy();
 	}
 
-	AvailableObjects.Empty();
+	// Worker threads may still hold the queue
+	if (AsyncQueue.IsValid()) {
+		AsyncQueue->Close();
+		AsyncQueue.Reset();
+	}
+
+	FreeSlots.Empty();
+	DeadSlots.Empty();
+	ObjectsToSlots.Empty();
+	NamesToSlots.Empty();
+
+	Expirations.Empty();
+	ExpirationsHead = 0;
+
+	TickingObjects.Empty();
+
+	// The cluster gets collected with all its objects
+	ClusterRoot = nullptr;
+
+	// The instanced mesh is destroyed with the pool
+	InstancedMesh = nullptr;
+	FreeInstances.Empty();
+	UsedInstances.Empty();
 
 	// Clear all timers
-	if (DefaultObjectSettings.LifeSpan > 0) {
-		TArray<FTimerHandle> TimerHandles;
-		ObjectsToTimers.GenerateValueArray(TimerHandles);
-		for (auto& Timer : TimerHandles) {
-			GetWorldTimerManager().ClearTimer(Timer);
-		}
-	}
+	GetWorldTimerManager().ClearTimer(ShrinkTimer);
 
 	Super::Destroyed();
-}
\ No newline at end of file
+}
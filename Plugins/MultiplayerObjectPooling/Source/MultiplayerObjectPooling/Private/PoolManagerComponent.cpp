@@ -1,34 +1,261 @@
 // Copyright 2019 (C) Ramn Janousch
 
 #include "PoolManagerComponent.h"
-
+#include "Engine.h"
+#include "PoolableInterface.h"
 
 // Sets default values for this component's properties
 UPoolManagerComponent::UPoolManagerComponent()
 {
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = true;
-
-	// ...
+	// The pools are only touched on acquire and release
+	PrimaryComponentTick.bCanEverTick = false;
 }
 
-
 // Called when the game starts
 void UPoolManagerComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// ...
-	
+	for (const FComponentPoolSpecification& PoolSpecification : DesiredPools) {
+		InitializeComponentPool(PoolSpecification);
+	}
 }
 
+void UPoolManagerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	// The components are owned by the actor, they only have to be destroyed if the actor stays
+	AActor* Owner = GetOwner();
+	if (IsValid(Owner) && !Owner->IsActorBeingDestroyed()) {
+		TArray<UClass*> Classes;
+		Pools.GetKeys(Classes);
+		for (UClass* Class : Classes) {
+			EmptyComponentPool(Class);
+		}
+	}
+	Pools.Empty();
 
-// Called every frame
-void UPoolManagerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
-{
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	Super::EndPlay(EndPlayReason);
+}
+
+UActorComponent* UPoolManagerComponent::GetComponentFromPool(TSubclassOf<UActorComponent> Class) {
+	return AcquireComponent(Class, nullptr, NAME_None, nullptr);
+}
 
-	// ...
+USceneComponent* UPoolManagerComponent::SpawnComponentFromPool(TSubclassOf<USceneComponent> Class, USceneComponent* AttachParent, FName SocketName, FTransform RelativeTransform) {
+	if (AttachParent == nullptr && GetOwner() != nullptr) {
+		AttachParent = GetOwner()->GetRootComponent();
+	}
+
+	return Cast<USceneComponent>(AcquireComponent(Class, AttachParent, SocketName, &RelativeTransform));
 }
 
+UActorComponent* UPoolManagerComponent::AcquireComponent(UClass* Class, USceneComponent* AttachParent, FName SocketName, const FTransform* RelativeTransform) {
+	if (Class == nullptr) {
+		UE_LOG(LogTemp, Error, TEXT("Pass a valid class which inherits from ActorComponent!"));
+		return nullptr;
+	}
+
+	FComponentPool* Pool = Pools.Find(Class);
+	if (Pool == nullptr) {
+		UE_LOG(LogTemp, Error, TEXT("There is no component pool for %s!"), *Class->GetName());
+		return nullptr;
+	}
+
+	UActorComponent* Component = nullptr;
+	uint8 DirtyFlags = EPoolDirtyFlags::None;
+	while (Component == nullptr) {
+		if (Pool->UnusedComponents.Num() == 0) {
+			int32 MaxNumberOfComponents = Pool->Specification.MaxNumberOfComponents;
+			if (MaxNumberOfComponents > 0 && Pool->UsedComponents.Num() >= MaxNumberOfComponents) return nullptr;
+
+			if (!AddComponent(Class)) return nullptr;
+			Pool = Pools.Find(Class);
+			if (Pool == nullptr) return nullptr;
+		}
+
+		Component = Pool->UnusedComponents.Pop(false);
+		DirtyFlags = Pool->DirtyFlags.Pop(false);
+
+		// Skip components which were destroyed from the outside
+		if (!IsValid(Component)) {
+			Component = nullptr;
+		}
+	}
+	Pool->UsedComponents.Add(Component);
+
+	// The relative transform is only stored and applied by the attachment, so the component is moved once and not before the registration
+	USceneComponent* SceneComponent = Cast<USceneComponent>(Component);
+	if (SceneComponent != nullptr) {
+		const FTransform& Transform = RelativeTransform != nullptr ? *RelativeTransform : Pool->DefaultSettings.RelativeTransform;
+		SceneComponent->SetRelativeLocation_Direct(Transform.GetLocation());
+		SceneComponent->SetRelativeRotation_Direct(Transform.Rotator());
+		SceneComponent->SetRelativeScale3D_Direct(Transform.GetScale3D());
+
+		if (AttachParent != nullptr) {
+			SceneComponent->AttachToComponent(AttachParent, FAttachmentTransformRules::KeepRelativeTransform, SocketName);
+		}
+		else if (SceneComponent->IsRegistered()) {
+			SceneComponent->UpdateComponentToWorld(EUpdateTransformFlags::None, ETeleportType::TeleportPhysics);
+		}
+	}
+
+	// The registration creates the render and physics state at the final transform
+	if (!Component->IsRegistered()) {
+		Component->RegisterComponent();
+	}
+
+	// Tick and activation are switched off while the component is unused, so these are always restored
+	uint8 RestoreFlags = (uint8)((DirtyFlags | EPoolDirtyFlags::Tick | EPoolDirtyFlags::Activation) & ~EPoolDirtyFlags::Transform);
+	APoolHolder::RestoreComponentSettings(Component, Pool->DefaultSettings, RestoreFlags);
+
+	UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(Component);
+	if (PrimitiveComponent != nullptr && PrimitiveComponent->IsSimulatingPhysics()) {
+		PrimitiveComponent->WakeAllRigidBodies();
+	}
+
+	if (Pool->DefaultSettings.bImplementsPoolableInterface) {
+		IPoolableInterface* NativePoolable = Pool->DefaultSettings.bHasNativePoolableCallbacks ? Cast<IPoolableInterface>(Component) : nullptr;
+		APoolHolder::CallPoolableInterface(Component, NativePoolable, true, EEndPlayReason::Destroyed);
+	}
+
+	return Component;
+}
+
+void UPoolManagerComponent::ReturnComponentToPool(UActorComponent* Component, const EEndPlayReason::Type EndPlayReason) {
+	if (!IsValid(Component)) return;
+
+	UClass* Class = Component->GetClass();
+	FComponentPool* Pool = Pools.Find(Class);
+	if (Pool == nullptr || Pool->UsedComponents.Remove(Component) == 0) {
+		UE_LOG(LogTemp, Error, TEXT("%s isn't a used component of this pool!"), *Component->GetName());
+		return;
+	}
+
+	if (Pool->DefaultSettings.bImplementsPoolableInterface) {
+		IPoolableInterface* NativePoolable = Pool->DefaultSettings.bHasNativePoolableCallbacks ? Cast<IPoolableInterface>(Component) : nullptr;
+		APoolHolder::CallPoolableInterface(Component, NativePoolable, false, EndPlayReason);
+
+		// The callback may have emptied the pool
+		Pool = Pools.Find(Class);
+		if (Pool == nullptr) return;
+	}
+
+	// Collected before the component is deactivated, so the acquire only has to restore the changed settings
+	Pool->DirtyFlags.Add(Pool->Specification.bDetectChangedSettings ? APoolHolder::GetComponentDirtyFlags(Component, Pool->DefaultSettings) : (uint8)EPoolDirtyFlags::None);
+	Pool->UnusedComponents.Add(Component);
+	DeactivateComponent(*Pool, Component);
+}
+
+void UPoolManagerComponent::InitializeComponentPool(FComponentPoolSpecification PoolSpecification) {
+	UClass* Class = PoolSpecification.Class;
+	if (Class == nullptr) {
+		UE_LOG(LogTemp, Error, TEXT("Pass a valid class which inherits from ActorComponent!"));
+		return;
+	}
+
+	if (Pools.Contains(Class)) {
+		UE_LOG(LogTemp, Error, TEXT("There is already a component pool for %s!"), *Class->GetName());
+		return;
+	}
+
+	int32 NumberOfComponents = PoolSpecification.NumberOfComponents;
+	if (PoolSpecification.MaxNumberOfComponents > 0) {
+		NumberOfComponents = FMath::Min(NumberOfComponents, PoolSpecification.MaxNumberOfComponents);
+	}
+
+	FComponentPool& Pool = Pools.Add(Class);
+	Pool.Specification = PoolSpecification;
+	Pool.UnusedComponents.Reserve(NumberOfComponents);
+	Pool.DirtyFlags.Reserve(NumberOfComponents);
+
+	for (int32 i = 0; i < NumberOfComponents; i++) {
+		if (!AddComponent(Class)) break;
+	}
+}
+
+bool UPoolManagerComponent::AddComponent(UClass* Class) {
+	AActor* Owner = GetOwner();
+	if (!IsValid(Owner)) return false;
+
+	UActorComponent* Component = NewObject<UActorComponent>(Owner, Class);
+	if (Component == nullptr) return false;
+
+	USceneComponent* SceneComponent = Cast<USceneComponent>(Component);
+	if (SceneComponent != nullptr) {
+		SceneComponent->SetupAttachment(Owner->GetRootComponent());
+	}
+	Component->RegisterComponent();
+
+	FComponentPool* Pool = Pools.Find(Class);
+	if (Pool == nullptr) {
+		Component->DestroyComponent();
+		return false;
+	}
+
+	// A fresh component matches the default settings, so nothing is dirty
+	if (!Pool->bHasDefaultSettings) {
+		Pool->DefaultSettings = APoolHolder::SaveComponentSettings(Component);
+		Pool->bHasDefaultSettings = true;
+	}
+	Pool->UnusedComponents.Add(Component);
+	Pool->DirtyFlags.Add(EPoolDirtyFlags::None);
+	DeactivateComponent(*Pool, Component);
+
+	return true;
+}
+
+void UPoolManagerComponent::DeactivateComponent(const FComponentPool& Pool, UActorComponent* Component) {
+	Component->SetComponentTickEnabled(false);
+	Component->Deactivate();
+
+	USceneComponent* SceneComponent = Cast<USceneComponent>(Component);
+	if (SceneComponent != nullptr) {
+		// Attached to a moving parent the component wouldn't stay at the parking location
+		SceneComponent->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+	}
+
+	if (Pool.Specification.DormancyMode == EComponentDormancyMode::Unregister) {
+		if (Component->IsRegistered()) {
+			Component->UnregisterComponent();
+		}
+		return;
+	}
+
+	if (SceneComponent != nullptr) {
+		// Only updates the transform of the render proxies instead of recreating them
+		SceneComponent->SetWorldLocation(Pool.Specification.ParkingLocation, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+
+	// Simulated bodies would fall away from the parking location, so they sleep until the component is used again
+	UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(Component);
+	if (PrimitiveComponent != nullptr && PrimitiveComponent->IsSimulatingPhysics()) {
+		PrimitiveComponent->SetAllPhysicsLinearVelocity(FVector::ZeroVector);
+		PrimitiveComponent->SetAllPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+		PrimitiveComponent->PutAllRigidBodiesToSleep();
+	}
+}
+
+void UPoolManagerComponent::EmptyComponentPool(TSubclassOf<UActorComponent> Class) {
+	FComponentPool Pool;
+	if (!Pools.RemoveAndCopyValue(Class, Pool)) return;
+
+	for (UActorComponent* Component : Pool.UnusedComponents) {
+		if (IsValid(Component)) {
+			Component->DestroyComponent();
+		}
+	}
+	for (UActorComponent* Component : Pool.UsedComponents) {
+		if (IsValid(Component)) {
+			Component->DestroyComponent();
+		}
+	}
+}
+
+int32 UPoolManagerComponent::GetNumberOfUsedComponents(TSubclassOf<UActorComponent> Class) const {
+	const FComponentPool* Pool = Pools.Find(Class);
+	return Pool != nullptr ? Pool->UsedComponents.Num() : -1;
+}
+
+int32 UPoolManagerComponent::GetNumberOfAvailableComponents(TSubclassOf<UActorComponent> Class) const {
+	const FComponentPool* Pool = Pools.Find(Class);
+	return Pool != nullptr ? Pool->UnusedComponents.Num() : -1;
+}
@@ -0,0 +1,255 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#include "Misc/AutomationTest.h"
+#include "Engine.h"
+#include "PoolBenchmark.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+BEGIN_DEFINE_SPEC(FPoolManagerSpec, "MultiplayerObjectPooling.PoolManager", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+	TUniquePtr<FPoolBenchmarkWorld> BenchmarkWorld;
+	APoolBenchmarkManager* PoolManager;
+	UWorld* World;
+
+	// Pool of plain actors, growth and shrinking are switched on by the tests which need them
+	FPoolSpecification MakePoolSpecification(int32 NumberOfObjects) {
+		FPoolSpecification PoolSpecification;
+		PoolSpecification.Class = APoolBenchmarkActor::StaticClass();
+		PoolSpecification.NumberOfObjects = NumberOfObjects;
+		return PoolSpecification;
+	}
+
+	// Tick the world long enough for the timers of the pools to fire
+	void AdvanceTime(float Seconds) {
+		World->Tick(LEVELTICK_All, Seconds);
+	}
+END_DEFINE_SPEC(FPoolManagerSpec)
+
+void FPoolManagerSpec::Define() {
+	BeforeEach([this]() {
+		BenchmarkWorld = MakeUnique<FPoolBenchmarkWorld>();
+		PoolManager = BenchmarkWorld->GetPoolManager();
+		World = BenchmarkWorld->GetWorld();
+
+		TestTrue(TEXT("The pool manager is registered for its world"), AAPoolManager::GetPoolManager(World) == PoolManager);
+	});
+
+	AfterEach([this]() {
+		BenchmarkWorld.Reset();
+	});
+
+	Describe("Acquire", [this]() {
+		It("should hand out an unused object", [this]() {
+			PoolManager->InitializeBenchmarkPools({ MakePoolSpecification(4) });
+
+			UObject* Object = AAPoolManager::GetFromPool(World, APoolBenchmarkActor::StaticClass());
+
+			TestNotNull(TEXT("Object"), Object);
+			TestTrue(TEXT("The object is active"), AAPoolManager::IsObjectActive(World, Object));
+			TestEqual(TEXT("Used objects"), AAPoolManager::GetNumberOfUsedObjects(World, APoolBenchmarkActor::StaticClass()), 1);
+			TestEqual(TEXT("Available objects"), AAPoolManager::GetNumberOfAvailableObjects(World, APoolBenchmarkActor::StaticClass()), 3);
+		});
+
+		It("should miss when a pool without growth is exhausted", [this]() {
+			PoolManager->InitializeBenchmarkPools({ MakePoolSpecification(4) });
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 4);
+			UObject* Object = AAPoolManager::GetFromPool(World, APoolBenchmarkActor::StaticClass());
+
+			FPoolMetrics Metrics;
+			AAPoolManager::GetPoolMetrics(World, APoolBenchmarkActor::StaticClass(), Metrics);
+
+			TestEqual(TEXT("Batch objects"), Objects.Num(), 4);
+			TestNull(TEXT("Object of the exhausted pool"), Object);
+			TestEqual(TEXT("Misses"), Metrics.Misses, 1);
+		});
+	});
+
+	Describe("Release", [this]() {
+		It("should make a returned object available again", [this]() {
+			PoolManager->InitializeBenchmarkPools({ MakePoolSpecification(4) });
+
+			UObject* Object = AAPoolManager::GetFromPool(World, APoolBenchmarkActor::StaticClass());
+			AAPoolManager::ReturnToPool(World, Object);
+
+			TestFalse(TEXT("The object is active"), AAPoolManager::IsObjectActive(World, Object));
+			TestEqual(TEXT("Used objects"), AAPoolManager::GetNumberOfUsedObjects(World, APoolBenchmarkActor::StaticClass()), 0);
+			TestEqual(TEXT("Available objects"), AAPoolManager::GetNumberOfAvailableObjects(World, APoolBenchmarkActor::StaticClass()), 4);
+		});
+
+		It("should ignore an object which is returned twice", [this]() {
+			PoolManager->InitializeBenchmarkPools({ MakePoolSpecification(4) });
+
+			UObject* Object = AAPoolManager::GetFromPool(World, APoolBenchmarkActor::StaticClass());
+			AAPoolManager::ReturnToPool(World, Object);
+			AAPoolManager::ReturnToPool(World, Object);
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 5);
+
+			TestEqual(TEXT("Batch objects"), Objects.Num(), 4);
+			TestEqual(TEXT("Unique batch objects"), TSet<UObject*>(Objects).Num(), 4);
+		});
+	});
+
+	Describe("Grow", [this]() {
+		It("should grow by count up to the maximum number of objects", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.GrowthPolicy = EPoolGrowthPolicy::ByCount;
+			PoolSpecification.GrowthCount = 3;
+			PoolSpecification.MaxNumberOfObjects = 6;
+			PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 6);
+			UObject* Object = AAPoolManager::GetFromPool(World, APoolBenchmarkActor::StaticClass());
+
+			TestEqual(TEXT("Batch objects"), Objects.Num(), 6);
+			TestNull(TEXT("Object above the maximum"), Object);
+			TestEqual(TEXT("Used objects"), AAPoolManager::GetNumberOfUsedObjects(World, APoolBenchmarkActor::StaticClass()), 6);
+		});
+
+		It("should grow by factor", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.GrowthPolicy = EPoolGrowthPolicy::ByFactor;
+			PoolSpecification.GrowthFactor = 2.f;
+			PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 5);
+
+			TestEqual(TEXT("Batch objects"), Objects.Num(), 5);
+			TestEqual(TEXT("Available objects"), AAPoolManager::GetNumberOfAvailableObjects(World, APoolBenchmarkActor::StaticClass()), 3);
+		});
+	});
+
+	Describe("Warm up", [this]() {
+		It("should create a pending object instead of missing", [this]() {
+			APoolHolder* PoolHolder = World->SpawnActor<APoolHolder>();
+			PoolHolder->InitializePool(MakePoolSpecification(4), true);
+
+			UObject* Object = PoolHolder->GetUnused();
+
+			TestNotNull(TEXT("Object of the warming pool"), Object);
+			TestEqual(TEXT("Objects"), PoolHolder->GetNumberOfObjects(), 1);
+			TestFalse(TEXT("The pool is filled"), PoolHolder->IsFilled());
+		});
+
+		It("should count pending objects towards the maximum number of objects", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.GrowthPolicy = EPoolGrowthPolicy::ByCount;
+			PoolSpecification.GrowthCount = 4;
+			PoolSpecification.MaxNumberOfObjects = 4;
+			APoolHolder* PoolHolder = World->SpawnActor<APoolHolder>();
+			PoolHolder->InitializePool(PoolSpecification, true);
+
+			for (int32 i = 0; i < 4; i++) {
+				PoolHolder->GetUnused();
+			}
+			PoolHolder->Fill(TNumericLimits<double>::Max());
+
+			TestNull(TEXT("Object above the maximum"), PoolHolder->GetUnused());
+			TestEqual(TEXT("Objects"), PoolHolder->GetNumberOfObjects(), 4);
+		});
+	});
+
+	Describe("Async", [this]() {
+		It("should release an object which a worker spawned in the same frame", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.AsyncReservations = 2;
+			APoolHolder* PoolHolder = World->SpawnActor<APoolHolder>();
+			PoolHolder->InitializePool(PoolSpecification);
+
+			// Stocks the reservations
+			PoolHolder->ProcessAsyncRequests();
+
+			TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> AsyncQueue = PoolHolder->GetAsyncQueue();
+			int32 Handle = AsyncQueue->Reserve();
+			AsyncQueue->Spawn(Handle);
+			AsyncQueue->Release(Handle);
+			PoolHolder->ProcessAsyncRequests();
+
+			FPoolMetrics Metrics = PoolHolder->GetMetrics();
+
+			TestNotEqual(TEXT("Handle"), Handle, (int32)INDEX_NONE);
+			TestEqual(TEXT("Releases"), Metrics.Releases, 1);
+			TestEqual(TEXT("Used objects, only the reservations"), PoolHolder->GetNumberOfUsedObjects(), 2);
+		});
+
+		It("should ignore the handle of a reservation which was released without a spawn", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(1);
+			PoolSpecification.AsyncReservations = 1;
+			APoolHolder* PoolHolder = World->SpawnActor<APoolHolder>();
+			PoolHolder->InitializePool(PoolSpecification);
+			PoolHolder->ProcessAsyncRequests();
+
+			TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> AsyncQueue = PoolHolder->GetAsyncQueue();
+			int32 StaleHandle = AsyncQueue->Reserve();
+			AsyncQueue->Release(StaleHandle);
+			PoolHolder->ProcessAsyncRequests();
+
+			// The same slot is reserved again, the old handle must not spawn it
+			AsyncQueue->Spawn(StaleHandle);
+			PoolHolder->ProcessAsyncRequests();
+
+			FPoolMetrics Metrics = PoolHolder->GetMetrics();
+
+			TestEqual(TEXT("Acquires"), Metrics.Acquires, 0);
+			TestNotEqual(TEXT("Handle of the new reservation"), AsyncQueue->Reserve(), StaleHandle);
+		});
+	});
+
+	Describe("Shrink", [this]() {
+		It("should destroy idle objects down to the minimum number of objects", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.GrowthPolicy = EPoolGrowthPolicy::ByCount;
+			PoolSpecification.GrowthCount = 4;
+			PoolSpecification.ShrinkIdleTime = 1.f;
+			PoolSpecification.MinNumberOfObjects = 2;
+			PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 8);
+			AAPoolManager::ReturnMultipleToPool(World, Objects);
+
+			// The busiest moment is kept for one idle window, the next one trims the pool
+			for (int32 i = 0; i < 3; i++) {
+				AdvanceTime(1.1f);
+			}
+
+			TestEqual(TEXT("Available objects"), AAPoolManager::GetNumberOfAvailableObjects(World, APoolBenchmarkActor::StaticClass()), 2);
+		});
+
+		It("should keep the objects while the pool is still in demand", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.GrowthPolicy = EPoolGrowthPolicy::ByCount;
+			PoolSpecification.GrowthCount = 4;
+			PoolSpecification.ShrinkIdleTime = 1.f;
+			PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 8);
+			AAPoolManager::ReturnMultipleToPool(World, Objects);
+
+			// A single spawn within every idle window keeps the pool from shrinking
+			for (int32 i = 0; i < 6; i++) {
+				AdvanceTime(0.6f);
+				AAPoolManager::ReturnToPool(World, AAPoolManager::GetFromPool(World, APoolBenchmarkActor::StaticClass()));
+			}
+
+			TestEqual(TEXT("Available objects"), AAPoolManager::GetNumberOfAvailableObjects(World, APoolBenchmarkActor::StaticClass()), 8);
+		});
+
+		It("should keep objects which are in use", [this]() {
+			FPoolSpecification PoolSpecification = MakePoolSpecification(4);
+			PoolSpecification.ShrinkIdleTime = 1.f;
+			PoolManager->InitializeBenchmarkPools({ PoolSpecification });
+
+			TArray<UObject*> Objects = AAPoolManager::GetXFromPool(World, APoolBenchmarkActor::StaticClass(), 3);
+
+			for (int32 i = 0; i < 3; i++) {
+				AdvanceTime(1.1f);
+			}
+
+			TestEqual(TEXT("Used objects"), AAPoolManager::GetNumberOfUsedObjects(World, APoolBenchmarkActor::StaticClass()), 3);
+			TestEqual(TEXT("Available objects"), AAPoolManager::GetNumberOfAvailableObjects(World, APoolBenchmarkActor::StaticClass()), 0);
+		});
+	});
+}
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/StreamableManager.h"
 #include "PoolHolder.h"
 #include "APoolManager.generated.h"
 
@@ -11,9 +12,13 @@
 UENUM(BlueprintType)
 enum class EBranch : uint8 {
 	Success		UMETA(DisplayName="Success"),
-	Failed		UMETA(DisplayName="Failed")
+	Failed		UMETA(DisplayName="Failed"),
+	Loading		UMETA(DisplayName="Loading")
 };
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPoolReady, TSubclassOf<UObject>, Class);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnAllPoolsReady);
+
 UCLASS(Abstract)
 class AAPoolManager : public AActor
 {
@@ -21,76 +26,212 @@ class AAPoolManager : public AActor
 	
 public:
 
-	// Instance for this singleton
-	static AAPoolManager* Instance;
+	// Pools are keyed by the class itself, so lookups don't allocate and classes with the same name can't collide
+	TMap<UClass*, APoolHolder*> ClassesToPools;
+
+	// Gets called for every pool of DesiredPools as soon as it is completely filled, at the earliest in the frame after BeginPlay
+	UPROPERTY(BlueprintAssignable, Category = "Object Pool")
+		FOnPoolReady OnPoolReady;
 
-	TMap<FString, APoolHolder*> ClassNamesToPools;
+	// Gets called when all pools of DesiredPools are completely filled, at the earliest in the frame after BeginPlay. Check AreAllPoolsReady when binding late
+	UPROPERTY(BlueprintAssignable, Category = "Object Pool")
+		FOnAllPoolsReady OnAllPoolsReady;
 
 	// Sets default values for this actor's properties
 	AAPoolManager();
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (ToolTip = "Get a single object from the pool", DeterminesOutputType = "Class", Keywords = "Get Pool"))
-		static UObject* GetFromPool(TSubclassOf<UObject> Class);
+	virtual void Tick(float DeltaSeconds) override;
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the pool manager of the world. Every world has its own pools", Keywords = "Pool Manager World"))
+		static AAPoolManager* GetPoolManager(const UObject* WorldContextObject);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "True if OnAllPoolsReady was already called, bind to it otherwise", Keywords = "Pool Ready Loaded Warm"))
+		static bool AreAllPoolsReady(const UObject* WorldContextObject);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get a single object from the pool", DeterminesOutputType = "Class", Keywords = "Get Pool"))
+		static UObject* GetFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Multiplayer", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get a specific object from the pool by its name. Returns nothing while the object is reserved for a worker thread", DeterminesOutputType = "Class", Keywords = "Pool Specific Name String"))
+		static UObject* GetSpecificFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class, FString ObjectName);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get a variable number of objects from the pool", DeterminesOutputType = "Class", Keywords = "X Amount Number Quantity Pool"))
+		static TArray<UObject*> GetXFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class, int32 Quantity = 10);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get all unused objects from the pool", DeterminesOutputType = "Class", Keywords = "All Pool"))
+		static TArray<UObject*> GetAllFromPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", AdvancedDisplay = "PoolOwner,PoolInstigator", ToolTip = "Use this function like SpawnActor, but instead of creating a new actor it will take an unused one from the pool", DeterminesOutputType = "Class", ExpandEnumAsExecs = "Branch", Keywords = "Spawn Pool Get"))
+		static AActor* SpawnActorFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, FTransform SpawnTransform, UPARAM(DisplayName = "Owner") AActor* PoolOwner, UPARAM(DisplayName = "Instigator") APawn* PoolInstigator, EBranch& Branch);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Multiplayer", Meta = (WorldContext = "WorldContextObject", AdvancedDisplay = "PoolOwner,PoolInstigator", ToolTip = "Use this function like SpawnActor, but instead of creating a new actor it will take an unused one from the pool", DeterminesOutputType = "Class", ExpandEnumAsExecs = "Branch", Keywords = "Spawn Pool Get Multiplayer Network"))
+		static AActor* SpawnSpecificActorFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, FString ObjectName, FTransform SpawnTransform, UPARAM(DisplayName = "Owner") AActor* PoolOwner, UPARAM(DisplayName = "Instigator") APawn* PoolInstigator, EBranch& Branch);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Multiplayer", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get a specific object from the pool by its network id. Returns nothing while the object is reserved for a worker thread", Keywords = "Pool Specific Network Id Multiplayer"))
+		static UObject* GetFromPoolByNetId(const UObject* WorldContextObject, int32 NetId);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Multiplayer", Meta = (WorldContext = "WorldContextObject", AdvancedDisplay = "PoolOwner,PoolInstigator", ToolTip = "Use this function like SpawnActor, but instead of creating a new actor it will take the actor with the network id from the pool", ExpandEnumAsExecs = "Branch", Keywords = "Spawn Pool Get Multiplayer Network Id"))
+		static AActor* SpawnActorFromPoolByNetId(const UObject* WorldContextObject, int32 NetId, FTransform SpawnTransform, UPARAM(DisplayName = "Owner") AActor* PoolOwner, UPARAM(DisplayName = "Instigator") APawn* PoolInstigator, EBranch& Branch);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool|Multiplayer", Meta = (ToolTip = "Get a specific object from the pool by its name", DeterminesOutputType = "Class", Keywords = "Pool Specific Name String"))
-		static UObject* GetSpecificFromPool(TSubclassOf<UObject> Class, FString ObjectName);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", AdvancedDisplay = "PoolOwner,PoolInstigator", ToolTip = "Take one actor from the pool for every transform. All actors are placed before the first PoolableBeginPlay gets called", DeterminesOutputType = "Class", DynamicOutputParam = "SpawnedActors", ExpandEnumAsExecs = "Branch", Keywords = "Spawn Pool Get Batch Multiple Burst"))
+		static void SpawnActorsFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<FTransform>& SpawnTransforms, UPARAM(DisplayName = "Owner") AActor* PoolOwner, UPARAM(DisplayName = "Instigator") APawn* PoolInstigator, TArray<AActor*>& SpawnedActors, EBranch& Branch);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (ToolTip = "Get a variable number of objects from the pool", DeterminesOutputType = "Class", Keywords = "X Amount Number Quantity Pool"))
-		static TArray<UObject*> GetXFromPool(TSubclassOf<UObject> Class, int32 Quantity = 10);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Instancing", Meta = (WorldContext = "WorldContextObject", ToolTip = "Render an instance of the pooled actor instead of spawning it, the pool needs an instanced mesh. Returns -1 if there is no instance left", Keywords = "Spawn Instance Instanced Mesh Debris Pool"))
+		static int32 SpawnInstanceFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, FTransform SpawnTransform);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (ToolTip = "Get all unused objects from the pool", DeterminesOutputType = "Class", Keywords = "All Pool"))
-		static TArray<UObject*> GetAllFromPool(TSubclassOf<UObject> Class);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Instancing", Meta = (WorldContext = "WorldContextObject", ToolTip = "Render one instance of the pooled actor for every transform with a single render update, the pool needs an instanced mesh. Transforms which didn't get an instance get -1", Keywords = "Spawn Instance Instanced Mesh Debris Pool Batch Multiple"))
+		static void SpawnInstancesFromPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<FTransform>& SpawnTransforms, TArray<int32>& Instances);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (AdvancedDisplay = "PoolOwner,PoolInstigator", ToolTip = "Use this function like SpawnActor, but instead of creating a new actor it will take an unused one from the pool", DeterminesOutputType = "Class", ExpandEnumAsExecs = "Branch", Keywords = "Spawn Pool Get"))
-		static AActor* SpawnActorFromPool(TSubclassOf<AActor> Class, FTransform SpawnTransform, UPARAM(DisplayName = "Owner") AActor* PoolOwner, UPARAM(DisplayName = "Instigator") APawn* PoolInstigator, EBranch& Branch);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Instancing", Meta = (WorldContext = "WorldContextObject", ToolTip = "Move used instances with a single render update, one transform per instance", Keywords = "Update Move Transform Instance Instanced Mesh Pool Batch"))
+		static void UpdateInstances(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<int32>& Instances, const TArray<FTransform>& Transforms);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool|Multiplayer", Meta = (AdvancedDisplay = "PoolOwner,PoolInstigator", ToolTip = "Use this function like SpawnActor, but instead of creating a new actor it will take an unused one from the pool", DeterminesOutputType = "Class", ExpandEnumAsExecs = "Branch", Keywords = "Spawn Pool Get Multiplayer Network"))
-		static AActor* SpawnSpecificActorFromPool(TSubclassOf<AActor> Class, FString ObjectName, FTransform SpawnTransform, UPARAM(DisplayName = "Owner") AActor* PoolOwner, UPARAM(DisplayName = "Instigator") APawn* PoolInstigator, EBranch& Branch);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Instancing", Meta = (WorldContext = "WorldContextObject", ToolTip = "Hide used instances and give them back to the pool", Keywords = "Return Back Instance Instanced Mesh Pool Batch Multiple"))
+		static void ReturnInstancesToPool(const UObject* WorldContextObject, TSubclassOf<AActor> Class, const TArray<int32>& Instances);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (DefaultToSelf = "Object", ToolTip = "Put an used object back to the pool", Keywords = "Return Back Pool"))
-		static void ReturnToPool(UObject* Object, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Instancing", Meta = (WorldContext = "WorldContextObject", ToolTip = "Replace a used instance by a full actor from the same pool, e.g. when it has to collide or be picked up. Returns nothing if the pool has no unused actor", DeterminesOutputType = "Class", Keywords = "Materialize Actor Instance Instanced Mesh Pool"))
+		static AActor* MaterializeInstance(const UObject* WorldContextObject, TSubclassOf<AActor> Class, int32 Instance);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (ToolTip = "Clear a specific pool", Keywords = "Empty Clear Pool Destroy"))
-		static void EmptyObjectPool(TSubclassOf<UObject> Class);
+	UFUNCTION(BlueprintPure, Category = "Object Pool|Instancing", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the amount of used instances of the pool", Keywords = "Number Used Instance Instanced Mesh Pool"))
+		static int32 GetNumberOfUsedInstances(const UObject* WorldContextObject, TSubclassOf<AActor> Class);
 
-	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (ToolTip = "Create a new object pool. If you pass a class with an existing pool this will destroy all elements of the existing pool!", Keywords = "Init Create Start Pool"))
-		static void InitializeObjectPool(FPoolSpecification PoolSpecification);
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", DefaultToSelf = "Object", ToolTip = "Put an used object back to the pool", Keywords = "Return Back Pool"))
+		static void ReturnToPool(const UObject* WorldContextObject, UObject* Object, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Put multiple used objects back to their pools. Objects of the same class are returned together", Keywords = "Return Back Pool Batch Multiple"))
+		static void ReturnMultipleToPool(const UObject* WorldContextObject, const TArray<UObject*>& Objects, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Clear a specific pool", Keywords = "Empty Clear Pool Destroy"))
+		static void EmptyObjectPool(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Create a new object pool. If you pass a class with an existing pool this will destroy all elements of the existing pool! A soft class which isn't loaded yet is loaded asynchronously, OnPoolReady is called when the pool exists", Keywords = "Init Create Start Pool"))
+		static void InitializeObjectPool(const UObject* WorldContextObject, FPoolSpecification PoolSpecification);
 
 	UFUNCTION(BlueprintPure, Category = "Object Pool|Multiplayer", Meta = (ToolTip = "Get the name of the object for the function 'GetSpecificFromPool'", DefaultToSelf = "Object", Keywords = "Object Pool"))
 		static FString GetObjectName(UObject* Object);
 
-	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (ToolTip = "Get the amount of used objects of the pool"))
-		static int32 GetNumberOfUsedObjects(TSubclassOf<UObject> Class);
+	UFUNCTION(BlueprintPure, Category = "Object Pool|Multiplayer", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the network id of the object for the function 'GetFromPoolByNetId'. Peers which initialized the same pools get the same id. Returns -1 if the object isn't pooled", DefaultToSelf = "Object", Keywords = "Object Pool Network Id"))
+		static int32 GetNetId(const UObject* WorldContextObject, UObject* Object);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool|Multiplayer", Meta = (WorldContext = "WorldContextObject", ToolTip = "Find the pooled object of a network id without taking it from the pool. Returns nothing for unknown ids", Keywords = "Object Pool Network Id Find"))
+		static UObject* GetObjectByNetId(const UObject* WorldContextObject, int32 NetId);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the amount of used objects of the pool"))
+		static int32 GetNumberOfUsedObjects(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the amount of unused objects of the pool"))
+		static int32 GetNumberOfAvailableObjects(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
 
-	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (ToolTip = "Get the amount of unused objects of the pool"))
-		static int32 GetNumberOfAvailableObjects(TSubclassOf<UObject> Class);
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the highest number of objects of the pool which were in use at the same time. Use it to find the right pool size", Keywords = "Peak Usage Size"))
+		static int32 GetHighWaterMark(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
 
-	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (ToolTip = "Returns true if the object is NOT a part of the available object pool", Keywords = "Active Object Pool"))
-		static bool IsObjectActive(UObject* Object);
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Get the telemetry of the pool. Returns false if there is no pool for the class", Keywords = "Metrics Stats Telemetry Profiling"))
+		static bool GetPoolMetrics(const UObject* WorldContextObject, TSubclassOf<UObject> Class, FPoolMetrics& Metrics);
 
-	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (ToolTip = "Returns true if the object pool holds objects of the given class", Keywords = "Contains Object Pool"))
-		static bool ContainsClass(TSubclassOf<UObject> Class);
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Returns true if the object is NOT a part of the available object pool", Keywords = "Active Object Pool"))
+		static bool IsObjectActive(const UObject* WorldContextObject, UObject* Object);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Returns true if the object pool holds objects of the given class", Keywords = "Contains Object Pool"))
+		static bool ContainsClass(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Returns true if the pool of the given class finished its warm up. A pool which is still warming up can already hand out objects", Keywords = "Ready Warm Up Object Pool"))
+		static bool IsPoolReady(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool", Meta = (WorldContext = "WorldContextObject", ToolTip = "Returns true while the class of a soft referenced pool is still being loaded. Such a pool can't hand out objects yet. Pass the SoftClass of the pool specification, the class itself isn't available before the load", Keywords = "Loading Async Soft Object Pool"))
+		static bool IsPoolLoading(const UObject* WorldContextObject, TSoftClassPtr<UObject> SoftClass);
+
+	/*
+	* Get the thread safe front end of a pool for worker threads, only call it on the game thread.
+	* Returns null if the pool doesn't exist or has no AsyncReservations. The requests are handled once per frame by the pool manager
+	*/
+	static TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> GetAsyncQueue(const UObject* WorldContextObject, TSubclassOf<UObject> Class);
 
 protected:
 	UFUNCTION(BlueprintCallable, Category = "Object Pool", Meta = (ToolTip = "This will initialize all the pools defined by DesiredPools"))
 		void InitializePools();
 
+	// Replace the pools which get created by InitializePools
+	void SetDesiredPools(const TArray<FPoolSpecification>& PoolSpecifications);
+
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 private:
 
 	UPROPERTY(EditAnywhere)
 		TArray<FPoolSpecification> DesiredPools;
 
+	// Spread the creation of the DesiredPools across multiple frames instead of blocking BeginPlay
+	UPROPERTY(EditAnywhere, Category = "Warm Up")
+		bool bWarmUpOverTime;
+
+	// Time in milliseconds which may be spent per frame on creating pooled objects
+	UPROPERTY(EditAnywhere, Category = "Warm Up", Meta = (EditCondition = "bWarmUpOverTime", ClampMin = "0.1"))
+		float WarmUpBudgetMs;
+
 	bool bIsReady;
 
+	// OnAllPoolsReady was broadcast for the DesiredPools
+	bool bAllPoolsReady;
+
+	// Pools which still have to be filled, sorted by their warm up priority
+	UPROPERTY()
+		TArray<APoolHolder*> WarmingPools;
+
+	// Pools which accept requests from worker threads, the pool manager ticks as long as there are any
+	UPROPERTY()
+		TArray<APoolHolder*> AsyncPools;
+
+	// Loads the classes of soft referenced pools
+	FStreamableManager StreamableManager;
+
+	// Soft referenced pool classes which are still loading
+	TMap<FSoftObjectPath, TSharedPtr<FStreamableHandle>> LoadingPools;
+
+	// Pools by the index inside the network ids of their objects, the entries are cleared by the GC when a pool is destroyed
+	UPROPERTY()
+		TArray<APoolHolder*> PoolsByNetIndex;
+
+	// Network index of every pool class. DesiredPools are numbered by their position, so loading and warm up order don't matter
+	TMap<FSoftObjectPath, int32> ClassesToNetIndices;
+
 	void DestroyAllPools();
 
+	// Spawn a new pool holder and register it for its class
+	APoolHolder* CreatePoolHolder(const FPoolSpecification& PoolSpecification, bool bDeferFill);
+
+	// Register the pool under the network index of its class
+	void AssignNetIndex(APoolHolder* PoolHolder, UClass* Class);
+
+	// Create the pool directly or add it to the warming pools
+	void AddPool(const FPoolSpecification& PoolSpecification);
+
+	// Start loading the soft class of the pool, the pool will be added when the class is loaded
+	void LoadPoolClass(const FPoolSpecification& PoolSpecification);
+
+	void OnPoolClassLoaded(FPoolSpecification PoolSpecification);
+
+	// Fill the warming pools until the frame budget is used up
+	void WarmUpPools();
+
+	// Fire OnAllPoolsReady if no pool is loading or warming up anymore
+	void CheckAllPoolsReady();
+
+	// The broadcasts are deferred to the next tick, so listeners which bind in their BeginPlay don't miss them
+	void BroadcastPoolReady(TSubclassOf<UObject> Class);
+
+	void BroadcastAllPoolsReady();
+
 	/*
 	* Return false if the PoolManager doesn't contain the specific poolholder
 	*/
-	static bool GetPoolHolder(TSubclassOf<UObject> Class, APoolHolder*& PoolHolder);
+	static bool GetPoolHolder(const UObject* WorldContextObject, TSubclassOf<UObject> Class, APoolHolder*& PoolHolder);
+
+	// Returns nullptr if no pool uses the network index of the id
+	static APoolHolder* GetPoolHolderByNetId(const UObject* WorldContextObject, int32 NetId);
+
+	// Returns null and logs an error if the pool doesn't exist or has no instanced mesh
+	static APoolHolder* GetInstancedPoolHolder(const UObject* WorldContextObject, TSubclassOf<AActor> Class);
 
-	static bool IsPoolManagerReady();
+	bool IsPoolManagerReady() const;
 };
@@ -0,0 +1,103 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "GSRTClockSyncComponent.generated.h"
+
+// One round trip of a clock sync packet
+struct FGSRTClockSample {
+	// Local time in milliseconds when the answer arrived
+	double LocalTime;
+	double RoundTripTime;
+	// Server time minus local time
+	double Offset;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnGSRTClockSyncRequest, int64, ClientTime);
+
+/*
+* Estimates the server time from multiple clock sync round trips.
+* Send the ClientTime of OnSyncRequest as long at index 3 with CLOCK_SYNC_OPCODE. The relay answers with the
+* same time at index 3 and its own time at index 4, pass both to AddSample.
+* Round trips which took much longer than the median are ignored, the offset is the median of the remaining
+* samples and the drift between the clocks is corrected by a linear fit. Changes of the offset are applied
+* gradually, so the server time never jumps unless the error is large.
+*/
+UCLASS(ClassGroup = (GSRT), Meta = (BlueprintSpawnableComponent))
+class UGSRTClockSyncComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGSRTClockSyncComponent();
+
+	// Gets called whenever a clock sync packet should be sent
+	UPROPERTY(BlueprintAssignable, Category = "GSRT|Clock Sync")
+		FOnGSRTClockSyncRequest OnSyncRequest;
+
+	// Seconds between two clock sync packets once the clock is synchronized
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "GSRT|Clock Sync", Meta = (ClampMin = "0.1"))
+		float SyncInterval;
+
+	// Number of samples which are taken quickly after the start before the clock counts as synchronized
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "GSRT|Clock Sync", Meta = (ClampMin = "1"))
+		int32 InitialSamples;
+
+	// Errors above this are corrected at once instead of gradually
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "GSRT|Clock Sync", Meta = (ClampMin = "0"))
+		float SnapThresholdMs;
+
+	// Milliseconds the offset may change per second while it is corrected gradually
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "GSRT|Clock Sync", Meta = (ClampMin = "0"))
+		float MaxCorrectionMsPerSecond;
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Clock Sync", Meta = (ToolTip = "Add the answer of the relay to a clock sync packet", Keywords = "Clock Sync Sample Time"))
+		void AddSample(int64 ClientTime, int64 ServerTime);
+
+	UFUNCTION(BlueprintPure, Category = "GSRT|Clock Sync", Meta = (ToolTip = "Get the estimated time of the relay in milliseconds", Keywords = "Clock Sync Server Time"))
+		int64 GetServerTime() const;
+
+	UFUNCTION(BlueprintPure, Category = "GSRT|Clock Sync", Meta = (ToolTip = "Get the local time in milliseconds which clock sync packets are sent with", Keywords = "Clock Sync Local Time"))
+		int64 GetLocalTime() const;
+
+	UFUNCTION(BlueprintPure, Category = "GSRT|Clock Sync", Meta = (ToolTip = "Get the median round trip time in milliseconds", Keywords = "Clock Sync Ping Latency RTT"))
+		float GetRoundTripTime() const;
+
+	UFUNCTION(BlueprintPure, Category = "GSRT|Clock Sync", Meta = (ToolTip = "Returns true once enough samples were taken", Keywords = "Clock Sync Ready"))
+		bool IsSynchronized() const;
+
+	// Estimated server time with fractions of milliseconds
+	double GetServerTimePrecise() const;
+
+	double GetLocalTimePrecise() const;
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	static const int32 MaxSamples = 16;
+
+	// The newest samples, the oldest first
+	TArray<FGSRTClockSample> Samples;
+
+	float RoundTripTime;
+
+	// Offset at the reference time and the drift in milliseconds per millisecond
+	double TargetOffset;
+	double ReferenceTime;
+	double Drift;
+
+	// The offset which was applied when the last correction started
+	double PreviousOffset;
+	double CorrectionStartTime;
+
+	bool bIsSynchronized;
+
+	double GetTargetOffset(double LocalTime) const;
+
+	double GetOffset(double LocalTime) const;
+
+	// Update the offset and the drift from the samples
+	void Estimate();
+};
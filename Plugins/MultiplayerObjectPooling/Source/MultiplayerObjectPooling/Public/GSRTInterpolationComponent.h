@@ -0,0 +1,66 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "PoolableInterface.h"
+#include "GSRTInterpolationComponent.generated.h"
+
+class UGSRTClockSyncComponent;
+
+struct FGSRTTransformSnapshot {
+	// Server time in milliseconds
+	double Time;
+	FTransform Transform;
+};
+
+/*
+* Moves a remote actor smoothly between the received transforms instead of snapping to every update.
+* The actor is shown InterpolationDelayMs behind the estimated server time of the clock sync component, so there
+* are usually two snapshots around the displayed time. If updates are missing, the movement is extrapolated for
+* at most MaxExtrapolationMs, then the component stops ticking until the next snapshot arrives. The buffer is cleared
+* when the pooled actor returns to its pool.
+*/
+UCLASS(ClassGroup = (GSRT), Meta = (BlueprintSpawnableComponent))
+class UGSRTInterpolationComponent : public UActorComponent, public IPoolableInterface
+{
+	GENERATED_BODY()
+
+public:
+	UGSRTInterpolationComponent();
+
+	// Clock which the snapshot times are based on. If it isn't set, the clock of the first player controller or the game state is used
+	UPROPERTY(BlueprintReadWrite, Category = "GSRT|Interpolation")
+		UGSRTClockSyncComponent* ClockSync;
+
+	// How far the displayed movement is behind the server time, higher values hide more packet loss
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "GSRT|Interpolation", Meta = (ClampMin = "0"))
+		float InterpolationDelayMs;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "GSRT|Interpolation", Meta = (ClampMin = "0"))
+		float MaxExtrapolationMs;
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Interpolation", Meta = (ToolTip = "Add a received transform with the server time in milliseconds it was sent at", Keywords = "Snapshot Interpolation Movement Transform"))
+		void AddSnapshot(int64 ServerTime, const FTransform& Transform);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Interpolation", Meta = (ToolTip = "Forget all received transforms", Keywords = "Snapshot Interpolation Clear Reset"))
+		void ClearSnapshots();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	virtual void PoolableBeginPlay_Implementation() override;
+
+	virtual void PoolableEndPlay_Implementation(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	static const int32 MaxSnapshots = 32;
+
+	// Sorted by time, the oldest first
+	TArray<FGSRTTransformSnapshot> Snapshots;
+
+	UGSRTClockSyncComponent* FindClockSync();
+
+	// Get the transform at the time, returns false if there is no snapshot
+	bool SampleTransform(double Time, FTransform& Transform);
+};
@@ -0,0 +1,125 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "PoolableInterface.h"
+#include "GSRTReplicationComponent.generated.h"
+
+// Sequence numbers wrap around after 65535, a sequence is newer if it is less than half the range ahead
+namespace GSRTSequence
+{
+	inline bool IsNewer(uint16 Sequence, uint16 OtherSequence) {
+		return Sequence != OtherSequence && (uint16)(Sequence - OtherSequence) < 0x8000;
+	}
+}
+
+enum class EGSRTPropertyType : uint8 {
+	Bool,
+	Byte,
+	Int,
+	Float,
+	Vector,
+	Rotator,
+	String,
+	Name
+};
+
+// A replicated variable of the owner and how it is written into the bit stream
+struct FGSRTReplicatedProperty {
+	UProperty* Property;
+	EGSRTPropertyType Type;
+	// Floats and vectors are quantized to multiples of the precision, 0 sends the full float
+	float Precision;
+};
+
+// Encoded state of all replicated variables at one sequence
+struct FGSRTStateSnapshot {
+	uint16 Sequence;
+	// Every variable starts at a byte boundary, so two snapshots can be compared variable by variable
+	TArray<uint8> Data;
+	TArray<int32> ByteOffsets;
+	TArray<int32> NumBits;
+	// Peers which acknowledged this snapshot, only used by the sender
+	TArray<int32> AckedPeers;
+};
+
+/*
+* Packs the variables of the owning Blueprint which are marked as Replicated into a compact bit stream.
+* A state is sent as a delta against the newest state all target peers acknowledged, or as a full state
+* if there is no such state. Broadcasts without target peers use the known peers instead, these are the peers
+* which acknowledged a state or were registered with AddPeer. Put the payload into the RTData of a DEFAULT_OPCODE
+* packet and the relay forwards it under WRAPPER_PACKET_CODE. The receivers acknowledge the sequence returned by ReadState.
+*/
+UCLASS(ClassGroup = (GSRT), Meta = (BlueprintSpawnableComponent))
+class UGSRTReplicationComponent : public UActorComponent, public IPoolableInterface
+{
+	GENERATED_BODY()
+
+public:
+	UGSRTReplicationComponent();
+
+	// Precision of replicated vectors in centimeters, 0 sends the full floats
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "GSRT|Replication", Meta = (ClampMin = "0"))
+		float VectorPrecision;
+
+	// Precision of specific float or vector variables, floats without an entry are sent in full
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "GSRT|Replication")
+		TMap<FName, float> PropertyPrecisions;
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Replication", Meta = (ToolTip = "Write the replicated variables of the owner. The state is a delta if all target peers acknowledged an earlier state. Leave the target peers empty for a broadcast, which is a delta if all known peers acknowledged an earlier state", Keywords = "Replication Serialize Delta"))
+		void WriteState(const TArray<int32>& TargetPeers, TArray<uint8>& Payload);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Replication", Meta = (ToolTip = "Apply a received state to the owner. Returns false for outdated states, deltas against an unknown state and malformed payloads, the owner isn't changed then. Send the sequence back to the sender to acknowledge the state", Keywords = "Replication Deserialize Delta"))
+		bool ReadState(const TArray<uint8>& Payload, int32& Sequence);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Replication", Meta = (ToolTip = "Call this on the sender when a peer acknowledged a state", Keywords = "Replication Ack"))
+		void Acknowledge(int32 PeerId, int32 Sequence);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Replication", Meta = (ToolTip = "Call this on the sender when a peer connects. Broadcasts stay full states until the new peer acknowledged one, otherwise it would get deltas it can't read", Keywords = "Replication Peer Connect"))
+		void AddPeer(int32 PeerId);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Replication", Meta = (ToolTip = "Call this on the sender when a peer disconnects, otherwise broadcasts fall back to full states", Keywords = "Replication Peer Disconnect"))
+		void RemovePeer(int32 PeerId);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Replication", Meta = (ToolTip = "Forget all sent and received states, the next state will be a full state", Keywords = "Replication Reset Clear"))
+		void ResetReplication();
+
+	virtual void PoolableBeginPlay_Implementation() override;
+
+	virtual void PoolableEndPlay_Implementation(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Number of states which are kept as baselines
+	static const int32 HistorySize = 32;
+
+	TArray<FGSRTReplicatedProperty> Properties;
+
+	bool bHasProperties;
+
+	uint16 NextSequence;
+
+	// States which were sent, the oldest first
+	TArray<FGSRTStateSnapshot> SentStates;
+
+	// Receivers of the broadcasts, the baseline of a broadcast has to be acknowledged by all of them
+	TArray<int32> KnownPeers;
+
+	// States which were received, the oldest first
+	TArray<FGSRTStateSnapshot> ReceivedStates;
+
+	bool bHasReceivedState;
+
+	uint16 LastReceivedSequence;
+
+	// Collect the replicated variables of the owner once
+	void BuildProperties();
+
+	// Encode the current values of the replicated variables
+	void CaptureSnapshot(FGSRTStateSnapshot& Snapshot);
+
+	static void AddSnapshot(TArray<FGSRTStateSnapshot>& History, FGSRTStateSnapshot&& Snapshot);
+
+	static FGSRTStateSnapshot* FindSnapshot(TArray<FGSRTStateSnapshot>& History, uint16 Sequence);
+};
@@ -0,0 +1,68 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "GSRTSendQueueComponent.generated.h"
+
+// A single message of a batch
+USTRUCT(BlueprintType)
+struct FGSRTMessage {
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintReadWrite, Category = "GSRT")
+		TArray<uint8> Data;
+};
+
+// Messages of one frame which go to the same peers
+struct FGSRTBatch {
+	TArray<int32> TargetPeers;
+	TArray<uint8> Data;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnGSRTBatchReady, const TArray<uint8>&, Batch, const TArray<int32>&, TargetPeers);
+
+/*
+* Collects the messages of a frame and sends them as one packet per target set instead of one packet per message.
+* A batch is a sequence of messages which are prefixed with their length as a variable length integer.
+* Send the batch as Base64 string at index 1 with the op code of EGSRTDelivery::Batch, the relay forwards it as it is.
+* The Blueprint network component doesn't use the queue on its own, the README describes how to wire it up.
+*/
+UCLASS(ClassGroup = (GSRT), Meta = (BlueprintSpawnableComponent))
+class UGSRTSendQueueComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGSRTSendQueueComponent();
+
+	// Gets called at the end of the frame for every batch, send it with the op code of EGSRTDelivery::Batch
+	UPROPERTY(BlueprintAssignable, Category = "GSRT|Send Queue")
+		FOnGSRTBatchReady OnBatchReady;
+
+	// A batch is sent early when it would get bigger, keep it below the packet size of the realtime service
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "GSRT|Send Queue", Meta = (ClampMin = "16"))
+		int32 MaxBatchBytes;
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Send Queue", Meta = (ToolTip = "Queue a message, it is sent together with all other messages of this frame to the same peers. No target peers means all peers", Keywords = "Send Queue Batch Message"))
+		void Enqueue(const TArray<uint8>& Message, const TArray<int32>& TargetPeers);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT|Send Queue", Meta = (ToolTip = "Send all queued messages now instead of at the end of the frame", Keywords = "Send Queue Batch Flush"))
+		void Flush();
+
+	UFUNCTION(BlueprintPure, Category = "GSRT|Send Queue", Meta = (ToolTip = "Split a received batch into its messages. Returns false if the batch is malformed", Keywords = "Batch Split Messages Receive"))
+		static bool SplitBatch(const TArray<uint8>& Batch, TArray<FGSRTMessage>& Messages);
+
+	// Append a length prefixed message to a batch
+	static void AppendMessage(TArray<uint8>& Batch, const TArray<uint8>& Message);
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	// Batches of the current frame, there are only a few target sets per frame so they are searched linearly
+	TArray<FGSRTBatch> Batches;
+
+	void SendBatch(FGSRTBatch& Batch);
+};
@@ -6,6 +6,41 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "GSRTUtilities.generated.h"
 
+// How the relay forwards a packet
+UENUM(BlueprintType)
+enum class EGSRTDelivery : uint8 {
+	// Resent until it arrives and received in order, use it for events
+	Reliable				UMETA(DisplayName = "Reliable"),
+	// May get lost, outdated packets are dropped by their sequence. Use it for high frequency updates like movement
+	UnreliableSequenced		UMETA(DisplayName = "Unreliable Sequenced"),
+	// Reliable packet with the messages of UGSRTSendQueueComponent, the data is forwarded as it is
+	Batch					UMETA(DisplayName = "Batch")
+};
+
+// Which peers the relay forwards a broadcast to, the values match the realtime script
+UENUM(BlueprintType)
+enum class EGSRTRelevancy : uint8 {
+	Always			UMETA(DisplayName = "Always"),
+	// Nearby peers get every packet, peers far away only every fourth one
+	Spatial			UMETA(DisplayName = "Spatial"),
+	NearbyOnly		UMETA(DisplayName = "Nearby Only"),
+	Team			UMETA(DisplayName = "Team")
+};
+
+// Sequence numbers of an unreliable stream, e.g. the movement of one actor. The README describes how to send movement with it
+USTRUCT(BlueprintType)
+struct FGSRTSequenceChannel {
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+		uint16 NextSequence = 0;
+
+	// Newest sequence received from every sender peer
+	UPROPERTY()
+		TMap<int32, uint16> LastReceivedSequences;
+};
+
 /**
  * 
  */
@@ -19,5 +54,26 @@ public:
 
 	UFUNCTION(BlueprintPure, Category = "GSRT", Meta = (ToolTip = "Create a single object", DeterminesOutputType = "Class", Keywords = "Create Object"))
 		static UObject* CreateObject(TSubclassOf<UObject> Class);
+
+	UFUNCTION(BlueprintPure, Category = "GSRT", Meta = (ToolTip = "Encode bytes as a Base64 string, e.g. to put a replication payload into RTData", Keywords = "Base64 Bytes Payload Encode"))
+		static FString BytesToBase64(const TArray<uint8>& Bytes);
+
+	UFUNCTION(BlueprintPure, Category = "GSRT", Meta = (ToolTip = "Decode a Base64 string to bytes. Returns false if the string isn't valid Base64", Keywords = "Base64 Bytes Payload Decode"))
+		static bool Base64ToBytes(const FString& Base64, TArray<uint8>& Bytes);
+
+	UFUNCTION(BlueprintPure, Category = "GSRT", Meta = (ToolTip = "Get the op code to send a packet with, the relay forwards it with the same op code", Keywords = "OpCode Reliable Unreliable Delivery"))
+		static int32 GetDeliveryOpCode(EGSRTDelivery Delivery);
+
+	UFUNCTION(BlueprintPure, Category = "GSRT|Relevancy", Meta = (ToolTip = "Get the RTData indices for tagging a packet. Put the relevancy as long at RelevancyIndex, the team as long at TeamIndex and the position of the player as floats at PositionIndex to PositionIndex + 2. Packets which only carry a position update the position on the relay", Keywords = "Relevancy Interest Team Position Index"))
+		static void GetRelevancyDataIndices(int32& RelevancyIndex, int32& TeamIndex, int32& PositionIndex);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT", Meta = (ToolTip = "Get the sequence for the next unreliable packet of the channel, send it inside the packet data", Keywords = "Sequence Unreliable Channel"))
+		static int32 NextSequence(UPARAM(ref) FGSRTSequenceChannel& Channel);
+
+	UFUNCTION(BlueprintCallable, Category = "GSRT", Meta = (ToolTip = "Returns false if a newer packet of the sender was already received, the packet should be dropped then", Keywords = "Sequence Unreliable Channel Outdated Stale"))
+		static bool AcceptSequence(UPARAM(ref) FGSRTSequenceChannel& Channel, int32 SenderPeerId, int32 Sequence);
+
+	// Pack an integer so that small values of both signs use few bits, shared by all payloads of the plugin
+	static void SerializeZigZag(FArchive& Ar, int32& Value);
 	
 };
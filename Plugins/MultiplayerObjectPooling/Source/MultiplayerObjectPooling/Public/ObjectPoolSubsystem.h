@@ -0,0 +1,32 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ObjectPoolSubsystem.generated.h"
+
+class AAPoolManager;
+
+/*
+* Keeps track of the pool manager of a world, so every world (e.g. each PIE client, a dedicated server in the same
+* process or a benchmark world) has its own pools. The static functions of AAPoolManager resolve it through their world context.
+* World subsystems were added in UE 4.24, which is the minimum engine version of the plugin.
+*/
+UCLASS()
+class UObjectPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	AAPoolManager* GetPoolManager() const { return PoolManager; }
+
+	// Called by the pool manager in BeginPlay, only one pool manager per world is supported
+	void RegisterPoolManager(AAPoolManager* InPoolManager);
+
+	void UnregisterPoolManager(AAPoolManager* InPoolManager);
+
+private:
+	UPROPERTY()
+		AAPoolManager* PoolManager;
+};
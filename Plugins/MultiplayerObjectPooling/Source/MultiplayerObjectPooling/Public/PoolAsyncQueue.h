@@ -0,0 +1,79 @@
+// Copyright 2019 (C) Ramn Janousch
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Engine/EngineTypes.h"
+#include "Templates/Atomic.h"
+#include "Templates/UniquePtr.h"
+
+// Request of a worker thread, the pool handles it on the game thread
+struct FPoolAsyncRequest {
+	int32 SlotHandle;
+	uint32 Generation;
+	bool bRelease;
+	bool bHasTransform;
+	EEndPlayReason::Type EndPlayReason;
+	FTransform Transform;
+};
+
+/*
+* Thread safe front end of a single pool, e.g. for task graph jobs. Get it on the game thread with AAPoolManager::GetAsyncQueue
+* and pass it to the jobs, the shared pointer stays valid after the pool is destroyed.
+* The pool keeps a ring of reserved slot handles stocked, which worker threads take without locks. Spawn and release requests
+* go through a lock free queue and are handled by the pool in one batch per frame, before that the objects must not be touched.
+* The handles carry the generation of the slot, requests of a handle whose object went back to the pool in the meantime are ignored.
+*/
+class FPoolAsyncQueue
+{
+public:
+	FPoolAsyncQueue(int32 InPoolIndex, int32 Capacity);
+
+	// Take a reserved handle, returns INDEX_NONE if all reservations are used up until the next frame
+	int32 Reserve();
+
+	// Activate the object of a reserved handle
+	void Spawn(int32 Handle);
+
+	// Activate the object of a reserved handle, actors are moved to the transform before PoolableBeginPlay
+	void Spawn(int32 Handle, const FTransform& Transform);
+
+	// Return an object to the pool. Reserved objects which weren't spawned can be released too
+	void Release(int32 Handle, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+
+	// Get the network id of the object of the handle, e.g. to replicate an asynchronous spawn
+	int32 GetNetId(int32 Handle) const;
+
+	// Returns true after the pool was destroyed, all requests are ignored then
+	bool IsClosed() const;
+
+private:
+	friend class APoolHolder;
+
+	int32 PoolIndex;
+
+	// Ring of reserved handles. The game thread is the only producer, so it's enough to synchronize the consumers.
+	// Worker threads read entries while the game thread writes others, so every entry is atomic and the ring never reallocates
+	TUniquePtr<TAtomic<int32>[]> Reservations;
+	uint32 Mask;
+	TAtomic<uint32> Head;
+	TAtomic<uint32> Tail;
+
+	TQueue<FPoolAsyncRequest, EQueueMode::Mpsc> Requests;
+
+	TAtomic<bool> bClosed;
+
+	// Split the handle into the slot handle and the generation of the request
+	void Enqueue(int32 Handle, FPoolAsyncRequest& Request);
+
+	// Game thread only, returns false if the ring is full
+	bool AddReservation(int32 Handle);
+
+	int32 GetNumberOfReservations() const;
+
+	// Game thread only
+	bool Dequeue(FPoolAsyncRequest& Request);
+
+	void Close();
+};
@@ -3,10 +3,26 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/ArrayView.h"
 #include "GameFramework/Actor.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
+#include "PoolAsyncQueue.h"
 #include "PoolHolder.generated.h"
 
+UENUM(BlueprintType)
+enum class EPoolGrowthPolicy : uint8 {
+	None		UMETA(DisplayName="None"),
+	ByCount		UMETA(DisplayName="Grow By Count"),
+	ByFactor	UMETA(DisplayName="Grow By Factor")
+};
+
+UENUM(BlueprintType)
+enum class EPoolDormancyMode : uint8 {
+	Default		UMETA(DisplayName="Default", ToolTip="Attach To Pool, the same in the editor and in packaged builds"),
+	Attach		UMETA(DisplayName="Attach To Pool", ToolTip="Unused actors are hidden and attached to the pool, which keeps the outliner readable"),
+	Park		UMETA(DisplayName="Park", ToolTip="Unused actors are deactivated and moved to the parking location, they stay visible, collidable, registered and unattached. Only the transform of their render and physics state is updated, so keep the parking location out of sight and away from anything which reacts to overlaps")
+};
+
 USTRUCT(BlueprintType, Category = "Object Pool")
 struct FPoolSpecification {
 	GENERATED_BODY()
@@ -15,8 +31,68 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ToolTip = "Any class which inherites from UObject"))
 		TSubclassOf<UObject> Class;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ToolTip = "Only used if Class is empty. The class will be loaded asynchronously before the pool gets filled"))
+		TSoftClassPtr<UObject> SoftClass;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ToolTip = "The number of objects you want to have inside the pool"))
 		int32 NumberOfObjects;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ToolTip = "Pools with a higher priority are filled first when the pool manager warms up over time"))
+		int32 WarmUpPriority = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Growth", Meta = (ToolTip = "What the pool does when all of its objects are in use"))
+		EPoolGrowthPolicy GrowthPolicy = EPoolGrowthPolicy::None;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Growth", Meta = (ClampMin = "1", ToolTip = "The number of objects which will be added when the pool runs dry (Grow By Count)"))
+		int32 GrowthCount = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Growth", Meta = (ClampMin = "1.0", ToolTip = "The pool size will be multiplied by this factor when the pool runs dry (Grow By Factor)"))
+		float GrowthFactor = 1.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Growth", Meta = (ClampMin = "0", ToolTip = "The pool will never grow above this number of objects. 0 means no limit"))
+		int32 MaxNumberOfObjects = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Growth", Meta = (ClampMin = "0.0", ToolTip = "Unused objects will be destroyed after the pool was idle for this amount of seconds. 0 disables shrinking"))
+		float ShrinkIdleTime = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Growth", Meta = (ClampMin = "0", ToolTip = "The pool will never shrink below this number of objects"))
+		int32 MinNumberOfObjects = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dormancy", Meta = (ToolTip = "How unused actors are stored inside the pool"))
+		EPoolDormancyMode DormancyMode = EPoolDormancyMode::Default;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dormancy", Meta = (ToolTip = "World location of parked actors. Keep it out of sight and above the KillZ of the level"))
+		FVector ParkingLocation = FVector(0.f, 0.f, -50000.f);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dormancy", Meta = (ToolTip = "Compare returned actors and their components with the default settings, so changes made by gameplay code are undone on the next spawn. Switch it off for actors which undo their own changes in PoolableEndPlay, then the release skips the comparison and only the settings changed by the pool are restored"))
+		bool bDetectChangedSettings = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Async", Meta = (ClampMin = "0", ToolTip = "Number of objects which are kept reserved for worker threads, see AAPoolManager::GetAsyncQueue. Reserved objects count as used. 0 disables the access from worker threads"))
+		int32 AsyncReservations = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Garbage Collection", Meta = (ToolTip = "Put the objects of a non actor pool into one GC cluster when the pool is filled, so the garbage collector handles them like a single object. The cluster is dissolved when an object is taken from the pool and created again after all objects were returned, use it for reserve pools which stay dormant most of the time"))
+		bool bCreateGCCluster = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Garbage Collection", Meta = (EditCondition = "bCreateGCCluster", ClampMin = "0.01", ToolTip = "Seconds the pool has to stay unused before its GC cluster is created again, so a pool which is used now and then doesn't rebuild it every time"))
+		float GCClusterIdleTime = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Instancing", Meta = (ToolTip = "Render visual only actors like shell casings or debris as instances of one instanced static mesh, see AAPoolManager::SpawnInstancesFromPool. The mesh is taken from the first static mesh component of the class. Instances have no collision, a full actor is only taken from the pool by MaterializeInstance"))
+		bool bUseInstancedMesh = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Instancing", Meta = (ToolTip = "Use a hierarchical instanced static mesh, which culls and LODs the instances separately, so the shrunk unused instances cost almost nothing to render. Better for many instances which rarely move, the tree has to be rebuilt after updates"))
+		bool bUseHierarchicalInstances = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Instancing", Meta = (ClampMin = "0", ToolTip = "The number of instances which are created when the pool is initialized. The instances are doubled when all of them are in use. A plain instanced mesh still draws its unused instances, which are only shrunk at the parking location, so its render cost grows with this number instead of the used instances. Keep it close to the peak or use hierarchical instances"))
+		int32 NumberOfInstances = 256;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Instancing", Meta = (ClampMin = "0", ToolTip = "The instances will never grow above this number. 0 means no limit"))
+		int32 MaxNumberOfInstances = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tick", Meta = (ToolTip = "Tick the used objects from the pool in one loop over the native PoolableTick instead of one tick function per actor. Needs a C++ implementation of the poolable interface, the tick of the actors stays disabled"))
+		bool bBatchTick = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tick", Meta = (ToolTip = "Spread the PoolableTick calls of a batch tick over worker threads. Only for thread safe logic, PoolableTick must not spawn, return or modify other objects then"))
+		bool bParallelBatchTick = false;
 };
 
 // Used to remember the default object settings
@@ -28,6 +104,10 @@ public:
 	// Object Settings
 
 	bool bImplementsPoolableInterface;
+	// The interface is implemented in C++ and not overridden by a Blueprint, so it can be called directly
+	bool bHasNativePoolableCallbacks;
+	// At least one of the components implements the poolable interface
+	bool bComponentsImplementPoolableInterface;
 
 	// Actor Settings
 
@@ -48,21 +128,199 @@ struct FDefaultComponentSettings {
 public:
 	// ActorComponent Settings
 
-	bool bImplementsPoolableInterface;
-	bool bStartWithTickEnabled;
+	uint8 bImplementsPoolableInterface : 1;
+	uint8 bHasNativePoolableCallbacks : 1;
+	uint8 bStartWithTickEnabled : 1;
+	uint8 bAutoActivate : 1;
 	float TickInterval;
 	TArray<FName> Tags;
-	bool bAutoActivate;
 
 	// SceneComponent Settings
-	bool bIsSceneComponent;
+	uint8 bIsSceneComponent : 1;
+	uint8 bIsVisible : 1;
+	uint8 bIsHidden : 1;
 	FTransform RelativeTransform;
-	bool bIsVisible;
-	bool bIsHidden;
 
 	// StaticMeshComponent Settings
-	bool bIsStaticMeshComponent;
-	bool bIsSimulatingPhysics;
+	uint8 bIsStaticMeshComponent : 1;
+	uint8 bIsSimulatingPhysics : 1;
+
+	FDefaultComponentSettings()
+		: bImplementsPoolableInterface(false), bHasNativePoolableCallbacks(false), bStartWithTickEnabled(false), bAutoActivate(false), TickInterval(0.f)
+		, bIsSceneComponent(false), bIsVisible(false), bIsHidden(false), RelativeTransform(FTransform::Identity)
+		, bIsStaticMeshComponent(false), bIsSimulatingPhysics(false) {}
+};
+
+// Marks the settings of a pooled actor or component which differ from the default settings of the pool
+namespace EPoolDirtyFlags {
+	enum Type : uint8 {
+		None			= 0,
+		Tick			= 1 << 0,
+		TickInterval	= 1 << 1,
+		Tags			= 1 << 2,
+		Activation		= 1 << 3,
+		Transform		= 1 << 4,
+		Visibility		= 1 << 5,
+		Physics			= 1 << 6,
+		Damage			= 1 << 7
+	};
+}
+
+// A single entry of the dense slot array. The index of the slot is the handle of the pooled object.
+USTRUCT()
+struct FPoolSlot {
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(VisibleAnywhere)
+		UObject* Object;
+
+	// Components of the actor in the order of the default component settings, gathered once when the actor is added
+	UPROPERTY()
+		TArray<UActorComponent*> Components;
+
+	// Set if the pool can call the poolable interface of the object directly
+	class IPoolableInterface* NativePoolable;
+
+	// Position of this slot inside the FreeSlots stack, INDEX_NONE while the object is in use
+	int32 FreeIndex;
+
+	// Taken from the free stack for a worker thread, but not spawned yet
+	bool bIsReserved;
+
+	// Position of this slot inside the batch tick, INDEX_NONE while the object doesn't tick
+	int32 TickIndex;
+
+	// Changes on every acquire and release, so queued life span expirations and async requests of an earlier use are ignored
+	uint32 LifeSpanId;
+
+	// EPoolDirtyFlags of the actor, collected when the actor returns to the pool
+	uint8 ActorDirtyFlags;
+
+	// EPoolDirtyFlags for each of the cached components
+	TArray<uint8> ComponentDirtyFlags;
+
+	FPoolSlot() : Object(nullptr), NativePoolable(nullptr), FreeIndex(INDEX_NONE), bIsReserved(false), TickIndex(INDEX_NONE), LifeSpanId(0), ActorDirtyFlags(EPoolDirtyFlags::None) {}
+
+	FORCEINLINE bool IsAvailable() const { return FreeIndex != INDEX_NONE; }
+};
+
+// Telemetry of a single pool
+USTRUCT(BlueprintType, Category = "Object Pool")
+struct FPoolMetrics {
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 NumberOfObjects = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 NumberOfUsedObjects = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool", Meta = (ToolTip = "Highest number of objects which were in use at the same time"))
+		int32 HighWaterMark = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 Acquires = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 Releases = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool", Meta = (ToolTip = "Requested objects which the pool couldn't hand out"))
+		int32 Misses = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool", Meta = (ToolTip = "Objects which had to be created after the initialization because the pool ran dry"))
+		int32 SpawnFallbacks = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool", Meta = (ToolTip = "Instances of the instanced mesh, used or not. Every one of them is drawn by a non hierarchical instanced mesh"))
+		int32 NumberOfInstances = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 NumberOfUsedInstances = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 InstanceAcquires = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		int32 InstanceReleases = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		float AverageAcquireMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		float AverageReleaseMs = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Object Pool")
+		float AverageRestoreMs = 0.f;
+};
+
+// Raw counters behind FPoolMetrics
+struct FPoolCounters {
+	uint64 Acquires = 0;
+	uint64 Releases = 0;
+	uint64 Misses = 0;
+	uint64 SpawnFallbacks = 0;
+	uint64 InstanceAcquires = 0;
+	uint64 InstanceReleases = 0;
+	uint64 Restores = 0;
+	uint64 AcquireCycles = 0;
+	uint64 ReleaseCycles = 0;
+	uint64 RestoreCycles = 0;
+};
+
+/*
+* Network ids of pooled objects, the pool index is stored in the bits 20 to 30 and the slot handle in the bits 0 to 19.
+* Peers which initialize the same pools assign the same ids, so a spawn can be replicated with a single integer.
+* Growing reuses the lowest dead slot before new slots are appended, and a peer which receives the id of a slot it
+* doesn't have grows until the slot exists. Pools on the receiving side should only hand out objects by their ids.
+*/
+namespace PoolNetId
+{
+	const int32 SlotBits = 20;
+	const int32 MaxSlots = 1 << SlotBits;
+	const int32 MaxPoolIndex = (1 << 11) - 1;
+
+	inline int32 Make(int32 PoolIndex, int32 SlotHandle) { return (PoolIndex << SlotBits) | SlotHandle; }
+	inline int32 GetPoolIndex(int32 NetId) { return NetId >> SlotBits; }
+	inline int32 GetSlotHandle(int32 NetId) { return NetId & (MaxSlots - 1); }
+}
+
+// Handles of FPoolAsyncQueue, the slot handle with the life span id the slot has while a worker thread owns it
+namespace PoolAsyncHandle
+{
+	const uint32 GenerationMask = (1 << (31 - PoolNetId::SlotBits)) - 1;
+
+	inline int32 Make(int32 SlotHandle, uint32 Generation) { return (int32)((Generation & GenerationMask) << PoolNetId::SlotBits) | SlotHandle; }
+	inline int32 GetSlotHandle(int32 Handle) { return PoolNetId::GetSlotHandle(Handle); }
+	inline uint32 GetGeneration(int32 Handle) { return (uint32)Handle >> PoolNetId::SlotBits; }
+	inline bool Matches(uint32 Generation, uint32 LifeSpanId) { return Generation == (LifeSpanId & GenerationMask); }
+}
+
+// Returns the object of the slot to the pool when its life span is over
+struct FPoolExpiration {
+	int32 SlotHandle;
+	uint32 LifeSpanId;
+	float ExpirationTime;
+};
+
+// Used object of a pool with a batch tick
+struct FPoolTickEntry {
+	// Null if the object stopped ticking during the loop
+	class IPoolableInterface* Poolable;
+	int32 SlotHandle;
+};
+
+// Root of the GC cluster of a pool
+UCLASS(Transient)
+class UPoolClusterRoot : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+		TArray<UObject*> Objects;
+
+	virtual bool CanBeClusterRoot() const override { return true; }
 };
 
 /**
@@ -72,7 +330,7 @@ UCLASS()
 class APoolHolder : public AActor
 {
 	GENERATED_BODY()
-	
+
 public:
 
 	APoolHolder();
@@ -80,39 +338,214 @@ public:
 	// Add a new object to the pool and deactivate it
 	void Add(UObject* Object);
 
-	// Get an unused object from the pool
-	UObject* GetUnused();
+	// Get an unused object from the pool. Actors are moved to the spawn transform instead of their default transform, if there is one
+	UObject* GetUnused(const FTransform* SpawnTransform = nullptr);
 
 	// Get all unused objects from the pool
 	TArray<UObject*> GetAllUnused();
 
+	/*
+	* Get multiple unused objects at once, the pool grows before if it is allowed to
+	* @param Quantity
+	* @param PrepareObject - called for every object before any PoolableBeginPlay of the batch, e.g. to set the owner
+	* @param SpawnTransforms - optional, one transform for each of the Quantity actors
+	* @return The number of objects which were taken from the pool
+	*/
+	int32 GetUnusedBatch(int32 Quantity, TFunctionRef<void(UObject* Object, int32 Index)> PrepareObject, const FTransform* SpawnTransforms = nullptr);
+
+	// Return multiple objects at once, PoolableEndPlay gets called after all objects are deactivated
+	void ReturnObjects(TArrayView<UObject*> Objects, const EEndPlayReason::Type EndPlayReason);
+
 	// Get a specific object by its name
-	UObject* GetSpecific(FString ObjectName);
+	UObject* GetSpecific(FString ObjectName, const FTransform* SpawnTransform = nullptr);
+
+	// Get a specific object by its slot handle, e.g. taken from a network id
+	UObject* GetSpecificBySlot(int32 SlotHandle, const FTransform* SpawnTransform = nullptr);
 
 	int32 GetNumberOfUsedObjects();
 
 	int32 GetNumberOfAvailableObjects();
 
+	// Get the number of objects which currently exist inside the pool, used or not
+	int32 GetNumberOfObjects();
+
+	// Get the highest number of objects that were in use at the same time
+	int32 GetHighWaterMark();
+
+	FPoolMetrics GetMetrics();
+
 	// Return an object to the pool
 	UFUNCTION()
 	void ReturnObject(UObject* Object, const EEndPlayReason::Type EndPlayReason);
 
-	// Initialize the pool with a given class and the amount of objects that the pool will contain
-	void InitializePool(FPoolSpecification PoolSpecification);
+	/*
+	* Initialize the pool with a given class and the amount of objects that the pool will contain
+	* @param PoolSpecification
+	* @param bDeferFill - only save the default settings, the objects have to be created by calling Fill
+	*/
+	void InitializePool(FPoolSpecification PoolSpecification, bool bDeferFill = false);
+
+	/*
+	* Create the objects which are still missing from the initialization
+	* @param EndTime - stop as soon as FPlatformTime::Seconds reaches this time, at least one object will be created
+	* @return True if the pool is completely filled
+	*/
+	bool Fill(double EndTime);
+
+	// Returns true if all objects of the initialization were created
+	bool IsFilled() const;
+
+	TSubclassOf<UObject> GetPoolClass() const;
+
+	const FPoolSpecification& GetSpecification() const;
 
 	bool IsObjectAvailable(UObject* Object);
 
+	// Get the slot handle of the object or INDEX_NONE if the object isn't a part of this pool
+	int32 GetSlotHandle(UObject* Object) const;
+
+	// Get the object stored inside the slot or nullptr for an invalid handle
+	UObject* GetObjectBySlot(int32 SlotHandle) const;
+
+	// Set by the pool manager, the index is a part of the network ids of the objects
+	void SetPoolIndex(int32 NewPoolIndex);
+
+	int32 GetPoolIndex() const;
+
+	// Get the network id of the object or INDEX_NONE if the object isn't a part of this pool
+	int32 GetNetId(UObject* Object) const;
+
+	// Null if the pool has no async reservations
+	TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> GetAsyncQueue() const;
+
+	// Handle the requests of the worker threads in one batch and restock the reservations
+	void ProcessAsyncRequests();
+
+	// Returns true if the pool renders its actors as instances
+	bool IsInstanced() const;
+
+	/*
+	* Take one instance for every transform, all instance transforms are updated with one render state update
+	* @param Transforms - world transforms of the actors, the relative transform of the mesh component is applied on top
+	* @param Instances - gets the index of every instance, INDEX_NONE for the transforms which didn't get an instance
+	* @return The number of instances which were taken from the pool
+	*/
+	int32 AcquireInstances(TArrayView<const FTransform> Transforms, TArray<int32>& Instances);
+
+	// Move used instances, the transforms are world transforms of the actors
+	void UpdateInstances(TArrayView<const int32> Instances, TArrayView<const FTransform> Transforms);
+
+	// Hide the instances and give them back to the pool
+	void ReleaseInstances(TArrayView<const int32> Instances);
+
+	/*
+	* Replace a used instance by a full actor of this pool at the same transform, e.g. when gameplay needs to interact with it
+	* @return Null if the instance isn't used or the pool has no unused actor
+	*/
+	AActor* MaterializeInstance(int32 Instance);
+
+	int32 GetNumberOfUsedInstances() const;
+
+	virtual void Tick(float DeltaSeconds) override;
+
 	virtual void Destroyed() override;
 
+	// The following functions are shared with the component pools of UPoolManagerComponent
+
+	// Returns true if the class implements the poolable interface in C++ and no Blueprint overrides its functions
+	static bool HasNativePoolableCallbacks(UClass* Class);
+
+	// Call PoolableBeginPlay or PoolableEndPlay, directly if NativePoolable is set
+	static void CallPoolableInterface(UObject* Object, class IPoolableInterface* NativePoolable, bool bIsActive, const EEndPlayReason::Type EndPlayReason);
+
+	// Save the current settings of the component as its default settings
+	static FDefaultComponentSettings SaveComponentSettings(UActorComponent* ActorComponent);
+
+	// Compare the component with its default settings, returns the EPoolDirtyFlags of the settings which differ
+	static uint8 GetComponentDirtyFlags(UActorComponent* ActorComponent, const FDefaultComponentSettings& ComponentSettings);
+
+	// Restore the settings of the component which were marked as dirty
+	static void RestoreComponentSettings(UActorComponent* ActorComponent, const FDefaultComponentSettings& ComponentSettings, uint8 DirtyFlags);
+
 private:
 
-	// Contains all the objects of this pool
-	UPROPERTY(EditAnywhere)
-		TMap<FString, UObject*> ObjectPool;
+	// Contains all the objects of this pool, the index of a slot is the handle of its object
+	UPROPERTY(VisibleAnywhere)
+		TArray<FPoolSlot> Slots;
+
+	// Null as long as the pool has no GC cluster
+	UPROPERTY()
+		UPoolClusterRoot* ClusterRoot;
+
+	// Null if the pool doesn't use an instanced mesh
+	UPROPERTY()
+		class UInstancedStaticMeshComponent* InstancedMesh;
+
+	// Relative transform of the mesh component inside the actor
+	FTransform InstanceMeshTransform;
+
+	// Stack of the indices of all hidden instances
+	TArray<int32> FreeInstances;
+
+	// One bit per instance, set while the instance is in use
+	TBitArray<> UsedInstances;
+
+	// Stack of the handles of all available objects
+	TArray<int32> FreeSlots;
+
+	// Handles of slots whose objects were destroyed by shrinking, sorted from the highest to the lowest. They are reused when the pool grows again
+	TArray<int32> DeadSlots;
+
+	// Used to find the slot of a returned object without any string operations
+	TMap<UObject*, int32> ObjectsToSlots;
+
+	// Lookup layer for the name based multiplayer functions
+	TMap<FName, int32> NamesToSlots;
+
+	// The specification this pool was initialized with, used for growing and shrinking
+	FPoolSpecification Specification;
+
+	// Index of this pool inside the network ids, INDEX_NONE if the pool can't be used over the network
+	int32 PoolIndex;
+
+	// Number of objects which still have to be created by Fill
+	int32 PendingObjects;
+
+	// Unused actors are parked instead of being attached to the pool
+	bool bParkActors;
+
+	// The used objects are ticked by the pool
+	bool bBatchTick;
+
+	// Used objects of a batch ticking pool, dense so the tick is a single loop
+	TArray<FPoolTickEntry> TickingObjects;
+
+	// Set during the loop, objects which stop ticking only clear their entry until the loop is done
+	bool bIsBatchTicking;
+	bool bHasTickingGaps;
+
+	// Highest number of used objects since the pool was initialized
+	int32 HighWaterMark;
+
+	// Highest number of used objects since the last shrink check
+	int32 IdleHighWaterMark;
 
-	// Contains all available object names
-	UPROPERTY(EditAnywhere)
-	TArray<FString> AvailableObjects;
+	// World time of the last acquire, the pool only shrinks after it wasn't asked for objects for a whole ShrinkIdleTime
+	float LastAcquireTime;
+
+	FTimerHandle ShrinkTimer;
+
+	// Creates the GC cluster again after the pool was unused for GCClusterIdleTime
+	FTimerHandle GCClusterTimer;
+
+	FPoolCounters Counters;
+
+	TSharedPtr<FPoolAsyncQueue, ESPMode::ThreadSafe> AsyncQueue;
+
+	// Stats of this pool inside the Object Pool stat group, named after the pool class
+	TStatId AcquireStatId;
+	TStatId ReleaseStatId;
+	TStatId RestoreStatId;
 
 	// Saves the default object settings to restore them, when the object is pulled from the pool
 	FDefaultObjectSettings DefaultObjectSettings;
@@ -120,24 +553,120 @@ private:
 	// Saves the default object components settings to restore them, when the object is pulled from the pool
 	TArray<FDefaultComponentSettings> DefaultComponentsSettings;
 
-	// This is only used when the object has a life span and triggers the return to pool function when the object dies
-	TMap<UObject*, FTimerHandle> ObjectsToTimers;
-	
-	/* 
+	/*
+	* Life span expirations of the used objects, replaces one timer per object.
+	* All objects of a pool share the same life span, so appending on acquire keeps the queue sorted by expiration time.
+	*/
+	TArray<FPoolExpiration> Expirations;
+
+	// Index of the next expiration inside Expirations, everything before it was already handled
+	int32 ExpirationsHead;
+
+	/*
 	* Activate or deactivate the object. On activation it will restore the default values
-	* @param Object
+	* @param SlotHandle - the slot of the object
 	* @param bIsActive
 	* @param EndPlayReason - will be passed to the EndPlay Interface function if implemented
 	*/
-	void SetObjectActive(UObject* Object, bool bIsActive = true, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+	void SetObjectActive(int32 SlotHandle, bool bIsActive = true, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+
+	// Activate the object without calling PoolableBeginPlay, an activated actor is moved to the spawn transform if there is one
+	void SetObjectState(int32 SlotHandle, bool bIsActive, const FTransform* SpawnTransform = nullptr);
+
+	// Also enables the tick of the pool, it is switched off again once nothing is left to tick
+	void AddToBatchTick(int32 SlotHandle);
+
+	void RemoveFromBatchTick(int32 SlotHandle);
+
+	// Call PoolableTick on all used objects and remove the entries of objects which stopped ticking meanwhile
+	void TickObjects(float DeltaSeconds);
+
+	// Call PoolableBeginPlay or PoolableEndPlay on the object and its components if they implement the interface
+	void NotifyPoolable(int32 SlotHandle, bool bIsActive, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+
+	void NotifyPoolableComponents(int32 SlotHandle, bool bIsActive, const EEndPlayReason::Type EndPlayReason);
+
+	/*
+	* Remove the slot from the free stack and activate its object
+	* @param SlotHandle
+	* @param SpawnTransform - optional, actors are moved there once instead of being restored to their default transform first
+	* @return The object of the slot, null if the slot is reserved for a worker thread
+	*/
+	UObject* AcquireSlot(int32 SlotHandle, const FTransform* SpawnTransform = nullptr);
+
+	// Restore and activate the object of a slot which was already removed from the free stack
+	void ActivateSlot(int32 SlotHandle, const FTransform* SpawnTransform = nullptr);
+
+	// Called on every acquire, also starts the idle window of the shrinking again
+	void UpdateHighWaterMarks();
+
+	/*
+	* Push the slot back onto the free stack and deactivate its object
+	* @param SlotHandle
+	* @param EndPlayReason
+	*/
+	void ReleaseSlot(int32 SlotHandle, const EEndPlayReason::Type EndPlayReason);
+
+	// Swap the slot out of the free stack in constant time
+	void RemoveFromFreeSlots(int32 SlotHandle);
+
+	// Create a new object of the pool class, actors will be spawned
+	UObject* CreatePoolObject();
+
+	/*
+	* Create one of the objects which are still warming up, otherwise add new objects according to the growth policy
+	* @return False if the pool isn't allowed to grow
+	*/
+	bool Grow();
+
+	/*
+	* Create objects until the slot of a network id exists, e.g. after the pool of the sender grew
+	* @return False if the pool isn't allowed to grow that far
+	*/
+	bool GrowToSlot(int32 SlotHandle);
+
+	// Destroy unused objects which weren't needed since the last check, as long as the pool was idle since then
+	void Shrink();
+
+	// Put all objects into one GC cluster if the specification asks for it and none of them is used
+	void CreateGCCluster();
+
+	// Clustered objects must not reference objects created later, so the cluster is dissolved before the first object gets used
+	void DissolveGCCluster();
+
+	// Restart the countdown to the next GC cluster once the last used object was returned
+	void ScheduleGCCluster();
+
+	// Create the instanced mesh from the first static mesh component of the default actor
+	void CreateInstancedMesh(AActor* DefaultActor);
+
+	/*
+	* Add hidden instances to the instanced mesh
+	* @return False if the instances aren't allowed to grow
+	*/
+	bool AddInstances(int32 Quantity);
+
+	bool IsInstanceUsed(int32 Instance) const;
+
+	// Queue the life span expiration of a freshly acquired object and enable the tick of the pool until it expired
+	void StartLifeSpan(int32 SlotHandle);
+
+	// Return all objects whose life span is over
+	void ReturnExpiredObjects();
+
+	// Destroy the unused object of the slot and remember the slot for reuse
+	void RemoveSlot(int32 SlotHandle);
+
+	// Activate or deactivate an actor of a pool which parks its unused actors
+	void SetParkedActorActive(FPoolSlot& Slot, AActor* Actor, bool bIsActive);
 
 	/*
-	* Get the specific object, set it active but don't remove it from the AvailableObjects array.
-	* @param ObjectName
-	* @return The specific Object
+	* Flag the root transform, which the pool changes itself, and compare the actor and its components with the default settings if bDetectChangedSettings is set.
+	* This happens when the actor returns to the pool, so the acquire only has to restore the changed settings.
 	*/
-	UObject* GetSpecificAndSetActive(FString ObjectName);
+	void UpdateDirtyFlags(FPoolSlot& Slot);
 
-	void RestoreActorSettings(AActor* Actor);
+	// Restore the settings which were marked as dirty, the transform of the root is skipped if the actor gets placed anyway
+	void RestoreActorSettings(FPoolSlot& Slot, bool bKeepRootTransform);
 
 };
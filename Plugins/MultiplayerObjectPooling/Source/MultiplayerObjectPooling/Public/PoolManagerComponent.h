@@ -4,26 +4,125 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "PoolHolder.h"
 #include "PoolManagerComponent.generated.h"
 
+UENUM(BlueprintType)
+enum class EComponentDormancyMode : uint8 {
+	Park		UMETA(DisplayName="Park", ToolTip="Unused components stay registered and deactivated, scene components are moved to the parking location. Like parked actors they stay visible and collidable, which keeps their render and physics state"),
+	Unregister	UMETA(DisplayName="Unregister", ToolTip="Unused components are unregistered, which frees their render and physics state but registers them again on every spawn")
+};
+
+USTRUCT(BlueprintType, Category = "Object Pool")
+struct FComponentPoolSpecification {
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ToolTip = "Any class which inherits from ActorComponent, e.g. audio, decal, particle or projectile movement components"))
+		TSubclassOf<UActorComponent> Class;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0", ToolTip = "The number of components which are created when the pool is initialized"))
+		int32 NumberOfComponents = 4;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Meta = (ClampMin = "0", ToolTip = "The pool creates a new component when all of its components are in use, but never more than this number. 0 means no limit"))
+		int32 MaxNumberOfComponents = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dormancy", Meta = (ToolTip = "How unused components are stored inside the pool"))
+		EComponentDormancyMode DormancyMode = EComponentDormancyMode::Park;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dormancy", Meta = (ToolTip = "World location of parked scene components. Keep it out of sight and above the KillZ of the level"))
+		FVector ParkingLocation = FVector(0.f, 0.f, -50000.f);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dormancy", Meta = (ToolTip = "Compare returned components with the default settings, so changes made by gameplay code are undone on the next spawn. Switch it off for components which undo their own changes in PoolableEndPlay, then only tick, activation and transform are restored"))
+		bool bDetectChangedSettings = true;
+};
+
+// All components of one class inside a component pool
+USTRUCT()
+struct FComponentPool {
+	GENERATED_BODY()
+
+public:
+	FComponentPoolSpecification Specification;
+
+	// Saved from the first component after its registration
+	FDefaultComponentSettings DefaultSettings;
+	bool bHasDefaultSettings = false;
+
+	UPROPERTY()
+		TArray<UActorComponent*> UnusedComponents;
 
+	// EPoolDirtyFlags for each of the unused components, collected when the component returns to the pool
+	TArray<uint8> DirtyFlags;
+
+	UPROPERTY()
+		TSet<UActorComponent*> UsedComponents;
+};
+
+/*
+* Pools components of its owner, e.g. the audio, decal or particle components of a weapon or a vehicle.
+* The actor pools can't help with components which are added and removed at runtime, mostly their registration is the expensive part.
+* The pooled components are created once, restored like the components of pooled actors and parked or unregistered while unused.
+*/
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class UPoolManagerComponent : public UActorComponent
 {
 	GENERATED_BODY()
 
-public:	
+public:
 	// Sets default values for this component's properties
 	UPoolManagerComponent();
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Object Pool", Meta = (ToolTip = "The component pools which get created in BeginPlay"))
+		TArray<FComponentPoolSpecification> DesiredPools;
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Component", Meta = (ToolTip = "Get an unused component from the pool. It is active if it auto activates and isn't attached to anything", DeterminesOutputType = "Class", Keywords = "Get Pool Component"))
+		UActorComponent* GetComponentFromPool(TSubclassOf<UActorComponent> Class);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Component", Meta = (AdvancedDisplay = "SocketName", ToolTip = "Use this function like AddComponent, but instead of creating a new component it will take an unused one from the pool. Without a parent it is attached to the root of the owner", DeterminesOutputType = "Class", Keywords = "Spawn Add Attach Pool Component"))
+		USceneComponent* SpawnComponentFromPool(TSubclassOf<USceneComponent> Class, USceneComponent* AttachParent, FName SocketName, FTransform RelativeTransform);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Component", Meta = (ToolTip = "Put an used component back to the pool", Keywords = "Return Back Pool Component"))
+		void ReturnComponentToPool(UActorComponent* Component, const EEndPlayReason::Type EndPlayReason = EEndPlayReason::Destroyed);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Component", Meta = (ToolTip = "Create a new component pool at runtime", Keywords = "Initialize Create Pool Component"))
+		void InitializeComponentPool(FComponentPoolSpecification PoolSpecification);
+
+	UFUNCTION(BlueprintCallable, Category = "Object Pool|Component", Meta = (ToolTip = "Destroy all components of a pool, used or not", Keywords = "Empty Clear Pool Destroy Component"))
+		void EmptyComponentPool(TSubclassOf<UActorComponent> Class);
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool|Component", Meta = (ToolTip = "Returns -1 if there is no pool for this class", Keywords = "Number Used Pool Component"))
+		int32 GetNumberOfUsedComponents(TSubclassOf<UActorComponent> Class) const;
+
+	UFUNCTION(BlueprintPure, Category = "Object Pool|Component", Meta = (ToolTip = "Returns -1 if there is no pool for this class", Keywords = "Number Available Unused Pool Component"))
+		int32 GetNumberOfAvailableComponents(TSubclassOf<UActorComponent> Class) const;
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
-public:	
-	// Called every frame
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UPROPERTY()
+		TMap<UClass*, FComponentPool> Pools;
+
+	/*
+	* Take an unused component or create a new one if the pool may grow, then restore and activate it
+	* @param Class
+	* @param AttachParent - scene components are attached to it before they are registered again
+	* @param SocketName
+	* @param RelativeTransform - optional, otherwise scene components keep their default relative transform
+	* @return Null if there is no pool for the class or it is exhausted
+	*/
+	UActorComponent* AcquireComponent(UClass* Class, USceneComponent* AttachParent, FName SocketName, const FTransform* RelativeTransform);
+
+	/*
+	* Create a new component for the pool and deactivate it. The pool is looked up again, because the component may create pools in its BeginPlay
+	* @return False if the component couldn't be created
+	*/
+	bool AddComponent(UClass* Class);
 
-		
-	
+	// Park or unregister the component
+	void DeactivateComponent(const FComponentPool& Pool, UActorComponent* Component);
 };
@@ -15,6 +15,8 @@ class UPoolableInterface : public UInterface
 
 /**
  * Use the interface functions instead of BeginPlay and EndPlay.
+ * C++ classes override the _Implementation functions. As long as a Blueprint child doesn't override them too,
+ * the pool calls them directly instead of going through the reflection system.
  */
 class IPoolableInterface
 {
@@ -25,13 +27,20 @@ public:
 	/*
 	* This function gets called when the object is pulled out of the pool
 	*/
-	UFUNCTION(BlueprintCallable, BlueprintImplementableEvent, Category = "Object Pool", Meta = (Tooltip = "Use this function instead of BeginPlay"))
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Object Pool", Meta = (Tooltip = "Use this function instead of BeginPlay"))
 		void PoolableBeginPlay();
 
 	/*
 	* Gets called when the object returns to the pool
 	* @param EndPlayReason
 	*/
-	UFUNCTION(BlueprintCallable, BlueprintImplementableEvent, Category = "Object Pool", Meta = (Tooltip = "Use this function instead of EndPlay"))
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Object Pool", Meta = (Tooltip = "Use this function instead of EndPlay"))
 		void PoolableEndPlay(const EEndPlayReason::Type EndPlayReason);
+
+	/*
+	* Gets called every frame while the object is used, if its pool has a batch tick. Replaces the tick of the actor
+	* and is native only, the pool calls it for all of its objects in one loop. Runs on worker threads with bParallelBatchTick
+	* @param DeltaSeconds
+	*/
+	virtual void PoolableTick(float DeltaSeconds) {}
 };